@@ -2,17 +2,39 @@
 // Scintilla platform for a curses (terminal) environment.
 
 #include <cassert>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
 #include <cmath>
 
 #include <stdexcept>
 #include <string>
+#include <charconv>
+#include <utility>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <list>
 #include <set>
 #include <optional>
 #include <algorithm>
+#include <numeric>
 #include <memory>
+#include <atomic>
+
+#if __AVX2__
+#include <immintrin.h>
+#elif __SSE2__
+#include <emmintrin.h>
+#endif
+
+#if !_WIN32
+#include <unistd.h>
+#include <sys/ioctl.h>
+#endif
 
 #include <curses.h>
 
@@ -55,6 +77,7 @@
 
 #include "ScintillaCurses.h"
 #include "PlatCurses.h"
+#include "UnicodeWidth.h"
 
 namespace Scintilla::Internal {
 
@@ -74,15 +97,6 @@ std::shared_ptr<Font> Font::Allocate(const FontParameters &fp) {
 
 namespace {
 
-short COLOR_LBLACK = COLOR_BLACK + 8;
-short COLOR_LRED = COLOR_RED + 8;
-short COLOR_LGREEN = COLOR_GREEN + 8;
-short COLOR_LYELLOW = COLOR_YELLOW + 8;
-short COLOR_LBLUE = COLOR_BLUE + 8;
-short COLOR_LMAGENTA = COLOR_MAGENTA + 8;
-short COLOR_LCYAN = COLOR_CYAN + 8;
-short COLOR_LWHITE = COLOR_WHITE + 8;
-
 bool initialized_colors = false;
 
 ColourRGBA BLACK(0, 0, 0);
@@ -104,76 +118,766 @@ ColourRGBA LWHITE(0xFF, 0xFF, 0xFF);
 ColourRGBA SCI_COLORS[] = {BLACK, RED, GREEN, YELLOW, BLUE, MAGENTA, CYAN, WHITE, LBLACK, LRED,
 	LGREEN, LYELLOW, LBLUE, LMAGENTA, LCYAN, LWHITE};
 
+bool direct_color = false; // whether curses colors are 24-bit RGB values
+std::vector<ColourRGBA> palette; // terminal colors, indexed by curses color
+constexpr int colorTableBits = 5; // per RGB component
+unsigned char color_table[1 << (3 * colorTableBits)]; // nearest palette color of each RGB cell
+
+// Returns the index of the given color's cell in `color_table`.
+int color_cell(ColourRGBA color) noexcept {
+	constexpr int shift = 8 - colorTableBits;
+	return (color.GetRed() >> shift) << (2 * colorTableBits) |
+		(color.GetGreen() >> shift) << colorTableBits | color.GetBlue() >> shift;
+}
+
+// Returns a weighted, squared distance between the given colors that roughly follows the
+// eye's sensitivity to each component.
+int color_distance(ColourRGBA a, ColourRGBA b) noexcept {
+	int dr = a.GetRed() - b.GetRed(), dg = a.GetGreen() - b.GetGreen(),
+			db = a.GetBlue() - b.GetBlue();
+	return 2 * dr * dr + 4 * dg * dg + 3 * db * db;
+}
+
+// Fills `palette` with the default colors of a terminal with the given number of colors:
+// the Scintilla colors, followed by xterm's color cube and grayscale ramp on 88- and 256-color
+// terminals.
+void init_palette(int colors) {
+	palette.assign(SCI_COLORS, SCI_COLORS + (colors < 16 ? 8 : 16));
+	if (colors < 88) return;
+	const std::vector<unsigned int> levels = colors >= 256 ?
+		std::vector<unsigned int>{0, 0x5F, 0x87, 0xAF, 0xD7, 0xFF} :
+		std::vector<unsigned int>{0, 0x8B, 0xCD, 0xFF};
+	for (unsigned int r : levels)
+		for (unsigned int g : levels)
+			for (unsigned int b : levels) palette.emplace_back(r, g, b);
+	if (colors >= 256)
+		for (unsigned int gray = 0x08; gray <= 0xEE; gray += 10) palette.emplace_back(gray, gray, gray);
+	else
+		for (unsigned int gray : {0x2E, 0x5C, 0x73, 0x8B, 0xA2, 0xB9, 0xD0, 0xE7})
+			palette.emplace_back(gray, gray, gray);
+}
+
+// Fills `color_table` with the nearest of the first *count* palette colors to the center of
+// each cell. Palette colors always map to themselves, with lower indices winning ties, and
+// light Scintilla colors map to their normal counterparts when there are only 8 colors.
+void init_color_table(size_t count) {
+	constexpr int size = 1 << colorTableBits, shift = 8 - colorTableBits;
+	for (int r = 0, cell = 0; r < size; r++)
+		for (int g = 0; g < size; g++)
+			for (int b = 0; b < size; b++, cell++) {
+				constexpr unsigned int center = 1 << (shift - 1);
+				ColourRGBA color(r << shift | center, g << shift | center, b << shift | center);
+				int nearest = 0, distance = color_distance(color, palette[0]);
+				for (size_t i = 1; i < count; i++)
+					if (int d = color_distance(color, palette[i]); d < distance)
+						nearest = static_cast<int>(i), distance = d;
+				color_table[cell] = nearest;
+			}
+	for (size_t i = count; i-- > 16;) color_table[color_cell(palette[i])] = i;
+	for (size_t i = 16; i-- > 0;)
+		color_table[color_cell(SCI_COLORS[i])] = i % std::min<size_t>(count, 16);
+}
+
+// Builds `palette` and `color_table` for a 256-color terminal if `init_colors()` has not built
+// them for the actual terminal yet. Colors then map sensibly before curses is set up, when
+// the terminal has no colors, and in headless windows, which draw with at least 256 colors.
+void default_colors() {
+	if (!palette.empty()) return;
+	init_palette(256);
+	init_color_table(palette.size());
+}
+
+// Color pairs are allocated on demand, after any pairs the application reserved, and recycled
+// when the terminal runs out of them, least recently used first. Pairs that cells on screen
+// still show are never recycled, since redefining them would recolor those cells.
+struct ColorPair {
+	int fore, back;
+	unsigned int cells = 0; // cells written to curses windows that still show the pair
+	bool pinned = false; // whether the application may show the pair, so it is never recycled
+};
+std::vector<ColorPair> pair_colors; // allocated pairs, after pair 0 and any reserved ones
+std::list<int> pair_lru; // allocated pairs, most recently used first
+std::unordered_map<uint64_t, std::list<int>::iterator> pair_cache; // (fore, back) to pair
+size_t max_pairs = 0;
+int reserved_pairs = 0; // pairs the application defines itself, after pair 0
+
+// Counts a cell on screen that now shows the first pair instead of the second.
+void show_pair(int pair, int previous) noexcept {
+	if (pair == previous) return;
+	const auto size = static_cast<int>(pair_colors.size());
+	if (pair > 0 && pair < size) pair_colors[pair].cells++;
+	if (previous > 0 && previous < size) pair_colors[previous].cells--;
+}
+
+uint64_t pair_key(int fore, int back) noexcept {
+	return static_cast<uint64_t>(static_cast<uint32_t>(fore)) << 32 | static_cast<uint32_t>(back);
+}
+
+// Returns whether the terminal has enough colors to show translucency.
+bool translucent_colors() {
+	default_colors();
+	return direct_color || palette.size() >= 256;
+}
+
 } // namespace
 
 /**
  * Initializes colors in curses if they have not already been initialized.
- * Creates all possible color pairs using the `SCI_COLOR_PAIR()` macro.
+ * Builds the table `term_color()` uses to look up the nearest terminal color of a Scintilla
+ * color. Color pairs are created as `color_pair()` needs them.
  * This is called automatically from `scintilla_new()`.
  */
 void init_colors() {
 	if (initialized_colors || !has_colors()) return;
 	start_color();
-	for (short back = 0; back < ((COLORS < 16) ? 8 : 16); back++)
-		for (short fore = 0; fore < ((COLORS < 16) ? 8 : 16); fore++)
-			init_pair(SCI_COLOR_PAIR(fore, back), fore, back);
-	if (COLORS < 16) {
-		// Do not distinguish between light and normal colors.
-		COLOR_LBLACK -= 8;
-		COLOR_LRED -= 8;
-		COLOR_LGREEN -= 8;
-		COLOR_LYELLOW -= 8;
-		COLOR_LBLUE -= 8;
-		COLOR_LMAGENTA -= 8;
-		COLOR_LCYAN -= 8;
-		COLOR_LWHITE -= 8;
+#if NCURSES_EXT_COLORS
+	direct_color = COLORS >= 0x1000000;
+	max_pairs = COLOR_PAIRS;
+#else
+	max_pairs = std::min(COLOR_PAIRS, SHRT_MAX + 1);
+#endif
+	// Pair 0 and the pairs reserved for the application are never allocated.
+	pair_colors.assign(reserved_pairs + 1, ColorPair{COLOR_WHITE, COLOR_BLACK});
+	pair_lru.clear(), pair_cache.clear();
+	if (!direct_color) {
+		init_palette(COLORS);
+		init_color_table(palette.size());
 	}
 	initialized_colors = true;
 }
 
 /**
- * Returns a curses color for the given Scintilla color.
- * Recognized colors are: black (0x000000), red (0x800000), green (0x008000), yellow (0x808000),
- * blue (0x000080), magenta (0x800080), cyan (0x008080), white (0xc0c0c0), light black (0x404040),
- * light red (0xff0000), light green (0x00ff00), light yellow (0xffff00), light blue (0x0000ff),
- * light magenta (0xff00ff), light cyan (0x00ffff), and light white (0xffffff). If the color
- * is not recognized, returns `COLOR_WHITE` by default.
+ * Returns the curses color nearest to the given Scintilla color.
+ * On direct color terminals, this is the color itself.
+ * Scintilla colors that exactly match one of the following terminal colors map to that color:
+ * black (0x000000), red (0x800000), green (0x008000), yellow (0x808000), blue (0x000080), magenta
+ * (0x800080), cyan (0x008080), white (0xc0c0c0), light black (0x404040), light red (0xff0000),
+ * light green (0x00ff00), light yellow (0xffff00), light blue (0x0000ff), light magenta
+ * (0xff00ff), light cyan (0x00ffff), and light white (0xffffff). On terminals with fewer
+ * than 16 colors, light colors map to their normal counterparts.
+ * Until colors are initialized, colors map to those of a 256-color terminal.
  * @param color Color to get a curses color for.
  * @return curses color
  */
-short term_color(ColourRGBA color) {
-	color = color.Opaque();
-	if (color == BLACK) return COLOR_BLACK;
-	if (color == RED) return COLOR_RED;
-	if (color == GREEN) return COLOR_GREEN;
-	if (color == YELLOW) return COLOR_YELLOW;
-	if (color == BLUE) return COLOR_BLUE;
-	if (color == MAGENTA) return COLOR_MAGENTA;
-	if (color == CYAN) return COLOR_CYAN;
-	if (color == LBLACK) return COLOR_LBLACK;
-	if (color == LRED) return COLOR_LRED;
-	if (color == LGREEN) return COLOR_LGREEN;
-	if (color == LYELLOW) return COLOR_LYELLOW;
-	if (color == LBLUE) return COLOR_LBLUE;
-	if (color == LMAGENTA) return COLOR_LMAGENTA;
-	if (color == LCYAN) return COLOR_LCYAN;
-	if (color == LWHITE) return COLOR_LWHITE;
-	return COLOR_WHITE;
+int term_color(ColourRGBA color) {
+	if (direct_color) return color.GetRed() << 16 | color.GetGreen() << 8 | color.GetBlue();
+	default_colors();
+	return color_table[color_cell(color)];
 }
 
 /**
  * Returns a curses color for the given curses color.
- * This overloaded method only exists for the `term_color_pair()` macro.
+ * This overloaded method only exists for the `term_color_pair()` macro. On direct color
+ * terminals, the basic curses colors are translated into their RGB values.
+ */
+int term_color(int color) {
+	return direct_color && color >= 0 && color < 16 ? term_color(SCI_COLORS[color]) : color;
+}
+
+/**
+ * Reserves color pairs 1 through *n* for the application, so `color_pair()` never defines them.
+ * This has no effect once colors are initialized.
+ * @param n The number of pairs to reserve.
+ * @return whether the pairs were reserved
+ */
+bool reserve_color_pairs(int n) {
+	if (initialized_colors) return false;
+	reserved_pairs = std::max(n, 0);
+	return true;
+}
+
+/**
+ * Returns a curses color pair for the given curses foreground and background colors.
+ * The pair is created if it does not exist yet. If the terminal has no more pairs available,
+ * the least recently used pair that no cell on screen shows is redefined. If every pair is
+ * shown, the default pair (0) is returned instead.
+ * @param fore The curses foreground color.
+ * @param back The curses background color.
+ * @return curses color pair, which may be larger than a `short` can hold
  */
-short term_color(short color) { return color; }
+int color_pair(int fore, int back) {
+	uint64_t key = pair_key(fore, back);
+	if (auto it = pair_cache.find(key); it != pair_cache.end()) {
+		pair_lru.splice(pair_lru.begin(), pair_lru, it->second);
+		return *it->second;
+	}
+	int pair = static_cast<int>(pair_colors.size());
+	if (pair_colors.size() < max_pairs)
+		pair_colors.push_back(ColorPair{fore, back});
+	else {
+		auto it = std::find_if(pair_lru.rbegin(), pair_lru.rend(),
+			[](int lru) { return pair_colors[lru].cells == 0 && !pair_colors[lru].pinned; });
+		if (it == pair_lru.rend()) return 0;
+		pair = *it, pair_lru.erase(std::next(it).base());
+		pair_cache.erase(pair_key(pair_colors[pair].fore, pair_colors[pair].back));
+		pair_colors[pair] = ColorPair{fore, back};
+	}
+#if NCURSES_EXT_COLORS
+	init_extended_pair(pair, fore, back);
+#else
+	init_pair(pair, fore, back);
+#endif
+	pair_lru.push_front(pair);
+	pair_cache[key] = pair_lru.begin();
+	return pair;
+}
+
+/**
+ * Returns `color_pair()` for the given curses foreground and background colors, and keeps that
+ * pair from ever being redefined, since something other than a `CellGrid` shows it.
+ * @param fore The curses foreground color.
+ * @param back The curses background color.
+ * @return curses color pair
+ */
+int pin_color_pair(int fore, int back) {
+	int pair = color_pair(fore, back);
+	if (pair > 0 && pair < static_cast<int>(pair_colors.size())) pair_colors[pair].pinned = true;
+	return pair;
+}
+
+/**
+ * Sets the attributes and color pair of the given window, including pairs too large for a
+ * `short`.
+ * @param win The curses window.
+ * @param attrs The curses attributes to set.
+ * @param pair The color pair to set, as returned by `color_pair()`.
+ */
+void term_attr_set(WINDOW *win, attr_t attrs, int pair) {
+#if NCURSES_EXT_COLORS
+	wattr_set(win, attrs, pair <= SHRT_MAX ? pair : 0, &pair);
+#else
+	wattr_set(win, attrs, pair, nullptr);
+#endif
+}
+
+// Cell grid handling.
+
+namespace {
+
+std::map<WindowID, CellGrid *> cell_grids; // grids that surfaces on those windows draw into
+
+// Moves the [top, bottom) rows of the given plane of *width* cells per row down by *n* rows
+// (up if *n* is negative). The rows moved out of are left as they were.
+template <typename T>
+void scroll_rows(std::vector<T> &plane, int width, int top, int bottom, int n) {
+	auto first = plane.begin() + static_cast<size_t>(top) * width;
+	auto last = plane.begin() + static_cast<size_t>(bottom) * width;
+	if (n > 0)
+		std::move_backward(first, last - static_cast<size_t>(n) * width, last);
+	else
+		std::move(first - static_cast<size_t>(n) * width, last, first);
+}
+
+} // namespace
+
+// The window the grid was written to no longer shows its cells.
+CellGrid::~CellGrid() {
+	for (int pair : shown) show_pair(0, pair);
+}
+
+// Resizing blanks the grid and implies every cell needs to be written.
+void CellGrid::Resize(int height_, int width_) {
+	height = std::max(height_, 0), width = std::max(width_, 0);
+	size_t size = static_cast<size_t>(height) * width;
+	text.assign(size, " "), fore.assign(size, WHITE), back.assign(size, BLACK);
+	attrs.assign(size, 0), dirty.assign(height, std::make_pair(0, width));
+	for (int pair : shown) show_pair(0, pair);
+	shown.assign(size, 0);
+}
+
+// Breaks up any wide cluster that covers the given cell so the cell can be overwritten. The
+// other half of that cluster becomes a space.
+void CellGrid::Split(size_t i) {
+	if (text[i].empty())
+		text[i - 1] = " ";
+	else if ((i + 1) % width != 0 && text[i + 1].empty())
+		text[i + 1] = " ";
+}
+
+// Marks the given columns as changed, along with their neighbors in case `Split()` changed them.
+void CellGrid::Touch(int y, int left, int right) {
+	left = std::max(left - 1, 0), right = std::min(right + 1, width);
+	auto &[l, r] = dirty[y];
+	if (l < r)
+		l = std::min(l, left), r = std::max(r, right);
+	else
+		l = left, r = right;
+}
+
+// Puts the given grapheme cluster in the given cell, or in that cell and the next one if
+// *cellWidth* is 2. A wide cluster in the last column is replaced with a space.
+void CellGrid::Put(int y, int x, std::string_view cluster, int cellWidth, ColourRGBA fore_,
+	ColourRGBA back_, attr_t attrs_) {
+	if (y < 0 || y >= height || x < 0 || x >= width) return;
+	if (x + cellWidth > width) cluster = " ", cellWidth = 1;
+	size_t i = static_cast<size_t>(y) * width + x;
+	for (size_t j = i; j < i + cellWidth; j++)
+		Split(j), text[j].clear(), fore[j] = fore_, back[j] = back_, attrs[j] = attrs_;
+	text[i] = cluster;
+	Touch(y, x, x + cellWidth);
+}
+
+// Puts the given curses character in the given cell, including any `ACS_*` character.
+void CellGrid::Put(int y, int x, chtype ch, ColourRGBA fore_, ColourRGBA back_) {
+	Fill(y, x, x + 1, ch, fore_, back_);
+}
+
+// Puts the given curses character in each of the given [left, right) columns of the given row.
+// Only wide clusters at either end of the span need splitting, since everything in between
+// is overwritten.
+void CellGrid::Fill(int y, int left, int right, chtype ch, ColourRGBA fore_, ColourRGBA back_) {
+	left = std::max(left, 0), right = std::min(right, width);
+	if (y < 0 || y >= height || left >= right) return;
+	size_t start = static_cast<size_t>(y) * width + left, end = start + (right - left);
+	Split(start), Split(end - 1);
+	auto c = static_cast<char>(ch & A_CHARTEXT);
+	for (size_t i = start; i < end; i++) text[i].assign(1, c);
+	std::fill(fore.begin() + start, fore.begin() + end, fore_);
+	std::fill(back.begin() + start, back.begin() + end, back_);
+	std::fill(attrs.begin() + start, attrs.begin() + end, ch & A_ATTRIBUTES & ~A_COLOR);
+	Touch(y, left, right);
+}
+
+// Appends the given zero-width character (e.g. a combining mark) to the cluster in the given
+// cell.
+void CellGrid::Combine(int y, int x, std::string_view mark) {
+	if (y < 0 || y >= height || x < 0 || x >= width) return;
+	size_t i = static_cast<size_t>(y) * width + x;
+	if (text[i].empty()) i--, x--; // right half of a wide cluster
+	if (attrs[i] & A_ALTCHARSET) return;
+	text[i] += mark;
+	Touch(y, x, x + 1);
+}
+
+ColourRGBA CellGrid::Back(int y, int x) const {
+	if (y < 0 || y >= height || x < 0 || x >= width) return BLACK;
+	return back[static_cast<size_t>(y) * width + x];
+}
+
+// Returns the text of the given cell along with its colors and attributes, or `nullptr` if the
+// cell is out of bounds. The text is empty for the right half of a wide cluster, and is the
+// character of an `ACS_*` character for cells with the `A_ALTCHARSET` attribute.
+const std::string *CellGrid::Get(
+	int y, int x, ColourRGBA &fore_, ColourRGBA &back_, attr_t &attrs_) const {
+	if (y < 0 || y >= height || x < 0 || x >= width) return nullptr;
+	size_t i = static_cast<size_t>(y) * width + x;
+	fore_ = fore[i], back_ = back[i], attrs_ = attrs[i];
+	return &text[i];
+}
+
+// Changes the background color of the given cell, leaving its text and foreground color intact.
+// The background of a wide cluster is the background of its left half.
+void CellGrid::SetBack(int y, int x, ColourRGBA back_) {
+	if (y < 0 || y >= height || x < 0 || x >= width) return;
+	back[static_cast<size_t>(y) * width + x] = back_;
+	Touch(y, x, x + 1);
+}
+
+// Returns the [left, right) columns of the given row that changed since they were last taken
+// or flushed, and forgets them.
+std::pair<int, int> CellGrid::TakeDirty(int y) {
+	if (y < 0 || y >= height) return std::make_pair(0, 0);
+	return std::exchange(dirty[y], std::make_pair(0, 0));
+}
+
+// Moves the [top, bottom) rows down by *n* rows (up if *n* is negative), like a terminal
+// scrolling a region. Moved rows keep their changed columns, and rows scrolled into view are
+// blanked and need writing.
+void CellGrid::Scroll(int top, int bottom, int n) {
+	top = std::max(top, 0), bottom = std::min(bottom, height);
+	if (n == 0 || top >= bottom) return;
+	n = std::clamp(n, top - bottom, bottom - top);
+	// The window scrolls too, so rows scrolled out of the region no longer show their pairs.
+	int lostTop = n > 0 ? bottom - n : top, lostBottom = n > 0 ? bottom : top - n;
+	for (size_t i = static_cast<size_t>(lostTop) * width; i < static_cast<size_t>(lostBottom) * width;
+			 i++)
+		show_pair(0, shown[i]);
+	if (std::abs(n) < bottom - top) {
+		scroll_rows(text, width, top, bottom, n), scroll_rows(fore, width, top, bottom, n);
+		scroll_rows(back, width, top, bottom, n), scroll_rows(attrs, width, top, bottom, n);
+		scroll_rows(shown, width, top, bottom, n), scroll_rows(dirty, 1, top, bottom, n);
+	}
+	int exposedTop = n > 0 ? top : bottom + n, exposedBottom = n > 0 ? top + n : bottom;
+	size_t first = static_cast<size_t>(exposedTop) * width;
+	size_t last = static_cast<size_t>(exposedBottom) * width;
+	std::fill(shown.begin() + first, shown.begin() + last, 0);
+	std::fill(text.begin() + first, text.begin() + last, " ");
+	std::fill(fore.begin() + first, fore.begin() + last, WHITE);
+	std::fill(back.begin() + first, back.begin() + last, BLACK);
+	std::fill(attrs.begin() + first, attrs.begin() + last, 0);
+	std::fill(dirty.begin() + exposedTop, dirty.begin() + exposedBottom, std::make_pair(0, width));
+}
+
+// Writes the cells that changed since the last flush to the given window. Runs of ASCII cells
+// with the same colors and attributes are written all at once, as are runs of the same
+// `ACS_*` character.
+void CellGrid::Flush(WINDOW *win) {
+	auto ascii = [this](size_t i) {
+		return text[i].length() == 1 && static_cast<unsigned char>(text[i][0]) < 0x80 &&
+			!(attrs[i] & A_ALTCHARSET);
+	};
+	auto same_style = [this](size_t i, size_t j) {
+		return attrs[j] == attrs[i] && fore[j] == fore[i] && back[j] == back[i];
+	};
+	for (int y = 0; y < height; y++) {
+		auto &[left, right] = dirty[y];
+		size_t row = static_cast<size_t>(y) * width;
+		if (left < right && text[row + left].empty()) left--; // start with the whole wide cluster
+		for (int x = left; x < right;) {
+			size_t i = row + x;
+			if (text[i].empty()) {
+				x++;
+				continue;
+			}
+			int pair = term_color_pair(fore[i], back[i]);
+			term_attr_set(win, attrs[i] & ~A_ALTCHARSET, pair);
+			if (ascii(i)) {
+				run.clear();
+				for (size_t j = i; x < right && ascii(j) && same_style(i, j); j++, x++) run += text[j][0];
+				mvwaddnstr(win, y, static_cast<int>(i - row), run.data(), static_cast<int>(run.length()));
+				count_stat(cellsWritten, run.length()), count_stat(bytesWritten, run.length());
+			} else if (attrs[i] & A_ALTCHARSET) {
+				int n = 0;
+				while (x + n < right && text[i + n] == text[i] && same_style(i, i + n)) n++;
+				mvwhline(win, y, x, static_cast<unsigned char>(text[i][0]) | A_ALTCHARSET, n);
+				count_stat(cellsWritten, n), count_stat(bytesWritten, n);
+				x += n;
+			} else {
+				bool wide = x + 1 < width && text[i + 1].empty();
+				if (wide) mvwaddch(win, y, x + 1, ' '); // clear any wide character it overlaps
+				mvwaddnstr(win, y, x, text[i].data(), static_cast<int>(text[i].length()));
+				count_stat(cellsWritten, wide ? 2 : 1), count_stat(bytesWritten, text[i].length());
+				x += wide ? 2 : 1;
+			}
+			for (size_t j = i; j < row + x; j++) show_pair(pair, std::exchange(shown[j], pair));
+		}
+		left = right = 0;
+	}
+}
+
+// Draws a box in the given color pair around the edge of the given window, over the cells
+// there, and counts those cells as showing that pair until they are written again.
+void CellGrid::Box(WINDOW *win, int pair) {
+	term_attr_set(win, 0, pair);
+	box(win, '|', '-');
+	auto edge = [this, pair](int y, int x) {
+		show_pair(pair, std::exchange(shown[static_cast<size_t>(y) * width + x], pair));
+	};
+	for (int x = 0; x < width && height > 0; x++) edge(0, x), edge(height - 1, x);
+	for (int y = 1; y < height - 1 && width > 0; y++) edge(y, 0), edge(y, width - 1);
+}
+
+/**
+ * Registers the given cell grid for surfaces on the given window to draw into.
+ * Passing `nullptr` unregisters any existing grid, and surfaces on that window draw nothing.
+ */
+void register_cell_grid(WindowID wid, CellGrid *grid) {
+	if (grid)
+		cell_grids[wid] = grid;
+	else
+		cell_grids.erase(wid);
+}
+
+/**
+ * Returns the cell grid of the given window if it is headless, or `nullptr`.
+ * Headless windows have no curses `WINDOW`. Instead, their `WindowID` is the grid registered
+ * for them.
+ */
+CellGrid *headless_grid(WindowID wid) {
+	auto it = cell_grids.find(wid);
+	return it != cell_grids.end() && static_cast<void *>(it->second) == wid ? it->second : nullptr;
+}
+
+// ANSI terminal output.
+
+namespace {
+
+// Returns the UTF-8 equivalent of the given VT100 line drawing character, as stored in cell
+// grids for `ACS_*` characters. Characters without one are returned as-is, except for the `0`
+// stored when curses was not initialized, which becomes a space.
+std::string acs_utf8(char c) {
+	switch (c) {
+	case '\0': return " ";
+	case '`': return "◆";
+	case 'a': return "▒";
+	case 'f': return "°";
+	case 'g': return "±";
+	case 'j': return "┘";
+	case 'k': return "┐";
+	case 'l': return "┌";
+	case 'm': return "└";
+	case 'n': return "┼";
+	case 'q': return "─";
+	case 't': return "├";
+	case 'u': return "┤";
+	case 'v': return "┴";
+	case 'w': return "┬";
+	case 'x': return "│";
+	case '~': return "·";
+	case '0': return "█";
+	default: return std::string(1, c);
+	}
+}
+
+// Returns the xterm 256-color palette index nearest to the given color.
+int xterm_color(ColourRGBA color) {
+	for (int i = 0; i < 16; i++)
+		if (color.OpaqueRGB() == SCI_COLORS[i].OpaqueRGB()) return i;
+	auto level = [](unsigned int c) { return c < 0x30 ? 0 : c < 0x73 ? 1 : (c - 0x23) / 0x28; };
+	auto value = [](int level) { return level > 0 ? 0x37 + 0x28 * level : 0; };
+	int r = level(color.GetRed()), g = level(color.GetGreen()), b = level(color.GetBlue());
+	ColourRGBA cube(value(r), value(g), value(b));
+	int average = (color.GetRed() + color.GetGreen() + color.GetBlue()) / 3;
+	int gray = std::clamp((average - 3) / 10, 0, 23);
+	ColourRGBA ramp(0x08 + 10 * gray, 0x08 + 10 * gray, 0x08 + 10 * gray);
+	if (color_distance(color, ramp) < color_distance(color, cube)) return 232 + gray;
+	return 16 + 36 * r + 6 * g + b;
+}
+
+// Returns the number of columns of the given terminal, or 0 if it is unknown.
+int terminal_columns(FILE *out) {
+#if !_WIN32
+	struct winsize size;
+	if (ioctl(fileno(out), TIOCGWINSZ, &size) == 0) return size.ws_col;
+#endif
+	return 0;
+}
+
+// Returns the escape sequence for the given CSI command with the given count, omitting a
+// count of 1 since it is the default.
+std::string csi(int n, char command) {
+	return "\033[" + (n != 1 ? std::to_string(n) : std::string()) + command;
+}
+
+} // namespace
+
+// Forgets the terminal's contents, cursor, and attributes so the next flush writes everything.
+// This is needed after something else writes to the terminal (e.g. clearing it).
+void AnsiScreen::Invalidate() noexcept {
+	stale = true, cursorY = cursorX = -1, sgrAttrs.reset(), cursorShown = -1;
+}
+
+// Moves the terminal cursor to the given cell with the shortest escape sequence, either
+// absolutely or relative to the cursor's current position.
+void AnsiScreen::MoveTo(int y, int x) {
+	if (y == cursorY && x == cursorX) return;
+	std::string move =
+		"\033[" + std::to_string(top + y + 1) + ';' + std::to_string(left + x + 1) + 'H';
+	if (cursorY >= 0 && cursorX >= 0) {
+		std::string relative;
+		if (y == cursorY + 1 && x == 0 && left == 0)
+			relative = "\r\n";
+		else {
+			if (y != cursorY) relative += csi(std::abs(y - cursorY), y < cursorY ? 'A' : 'B');
+			if (x == 0 && left == 0)
+				relative += '\r';
+			else if (x != cursorX)
+				relative += csi(std::abs(x - cursorX), x < cursorX ? 'D' : 'C');
+		}
+		if (relative.length() < move.length()) move = relative;
+	}
+	buffer += move, cursorY = y, cursorX = x;
+}
+
+// Returns the SGR parameters for the given foreground (*base* 38) or background (*base* 48)
+// color.
+std::string AnsiScreen::SGRColor(int base, ColourRGBA color) {
+	if (!trueColor) return std::to_string(base) + ";5;" + std::to_string(xterm_color(color));
+	return std::to_string(base) + ";2;" + std::to_string(color.GetRed()) + ';' +
+		std::to_string(color.GetGreen()) + ';' + std::to_string(color.GetBlue());
+}
+
+// Changes the terminal's current attributes and colors to the given ones, emitting parameters
+// only for what changed.
+void AnsiScreen::SetStyle(attr_t attrs_, ColourRGBA fore_, ColourRGBA back_) {
+	static const std::pair<attr_t, int> sgr[] = {{A_BOLD, 1}, {A_DIM, 2}, {A_ITALIC, 3},
+		{A_UNDERLINE, 4}, {A_BLINK, 5}, {A_REVERSE, 7}};
+	std::string params;
+	auto add = [&params](const std::string &param) {
+		if (!params.empty()) params += ';';
+		params += param;
+	};
+	attr_t current = sgrAttrs.value_or(0);
+	if (!sgrAttrs) add("0");
+	if (attr_t off = current & ~attrs_; off) {
+		if (off & (A_BOLD | A_DIM)) add("22"), current &= ~(A_BOLD | A_DIM); // turns off both
+		if (off & A_ITALIC) add("23");
+		if (off & A_UNDERLINE) add("24");
+		if (off & A_BLINK) add("25");
+		if (off & A_REVERSE) add("27");
+		current &= attrs_;
+	}
+	for (const auto &[attr, param] : sgr)
+		if ((attrs_ & attr) && !(current & attr)) add(std::to_string(param));
+	if (!sgrAttrs || fore_ != sgrFore) add(SGRColor(38, fore_));
+	if (!sgrAttrs || back_ != sgrBack) add(SGRColor(48, back_));
+	if (!params.empty()) buffer += "\033[" + params + 'm';
+	sgrAttrs = attrs_, sgrFore = fore_, sgrBack = back_;
+}
+
+// Writes the cells of the given grid that differ from the front buffer.
+// Only the cells the grid changed are compared, unless the front buffer is stale. Blank cells
+// look the same regardless of their foreground color, so that difference is ignored.
+void AnsiScreen::Flush(CellGrid &grid) {
+	constexpr attr_t mask = A_BOLD | A_DIM | A_ITALIC | A_UNDERLINE | A_BLINK | A_REVERSE;
+	if (grid.Height() != height || grid.Width() != width) {
+		height = grid.Height(), width = grid.Width(), stale = true;
+		size_t size = static_cast<size_t>(height) * width;
+		text.assign(size, ""), fore.assign(size, BLACK), back.assign(size, BLACK);
+		attrs.assign(size, 0);
+	}
+	int columns = terminal_columns(out);
+	bool rightEdge = columns > 0 && left + width == columns; // erasing to the EOL is safe
+	struct Cell {
+		const std::string *text;
+		ColourRGBA fore, back;
+		attr_t attrs;
+	};
+	auto cell_at = [&grid](int y, int x) {
+		Cell cell;
+		cell.text = grid.Get(y, x, cell.fore, cell.back, cell.attrs);
+		cell.attrs &= mask | A_ALTCHARSET;
+		return cell;
+	};
+	auto blank = [](const Cell &cell) {
+		return *cell.text == " " && !(cell.attrs & (A_UNDERLINE | A_REVERSE));
+	};
+	auto alike = [&blank](const Cell &a, const Cell &b) {
+		return *a.text == *b.text && a.back == b.back && a.attrs == b.attrs &&
+			(a.fore == b.fore || blank(a));
+	};
+	auto shown = [&](size_t i, const Cell &cell) {
+		return !stale && text[i] == *cell.text && back[i] == cell.back && attrs[i] == cell.attrs &&
+			(fore[i] == cell.fore || blank(cell));
+	};
+	for (int y = 0; y < height; y++) {
+		auto [l, r] = grid.TakeDirty(y);
+		if (stale) l = 0, r = width;
+		if (l > 0 && l < r && cell_at(y, l).text->empty()) l--; // start with the whole wide cluster
+		size_t row = static_cast<size_t>(y) * width;
+		for (int x = l; x < r;) {
+			size_t i = row + x;
+			Cell cell = cell_at(y, x);
+			if (cell.text->empty()) {
+				x++; // right half of a wide cluster that was already written
+				continue;
+			}
+			int cellWidth = x + 1 < width && cell_at(y, x + 1).text->empty() ? 2 : 1;
+			if (shown(i, cell) && (cellWidth == 1 || text[i + 1].empty())) {
+				x += cellWidth;
+				continue;
+			}
+			int n = 1; // the number of alike cells in a row, which are repeated or erased at once
+			if (cellWidth == 1)
+				while (x + n < r && alike(cell_at(y, x + n), cell)) n++;
+			MoveTo(y, x), SetStyle(cell.attrs & mask, cell.fore, cell.back);
+			if (rightEdge && x + n == width && n > 3 && blank(cell) && !(cell.attrs & mask))
+				buffer += "\033[K"; // erase to the end of the line; the cursor stays put
+			else {
+				std::string glyph = *cell.text;
+				if ((cell.attrs & A_ALTCHARSET) || glyph[0] == '\0') glyph = acs_utf8(glyph[0]);
+				buffer += glyph;
+				if (int repeat = n - 1; repeat > 0 && csi(repeat, 'b').length() < repeat * glyph.length())
+					buffer += csi(repeat, 'b');
+				else
+					for (int j = 1; j < n; j++) buffer += glyph;
+				cursorX += n * cellWidth;
+				if (cursorX >= width && (columns == 0 || rightEdge))
+					cursorY = cursorX = -1; // the terminal may or may not have wrapped
+			}
+			for (int j = 0; j < n * cellWidth; j++)
+				text[i + j] = j % cellWidth == 0 ? *cell.text : "", fore[i + j] = cell.fore,
+								back[i + j] = cell.back, attrs[i + j] = cell.attrs;
+			count_stat(cellsWritten, n * cellWidth);
+			x += n * cellWidth;
+		}
+	}
+	stale = false;
+}
+
+// Scrolls the terminal's rows showing the [top, bottom) rows of the grid down by *n* rows (up
+// if *n* is negative) using a scroll region, and moves the front buffer's rows to match. Rows
+// scrolled into view are forgotten so the next flush writes them.
+// Scroll regions span the terminal's width, so if the grid does not, the terminal is left
+// alone and the next flush rewrites the scrolled rows instead.
+void AnsiScreen::Scroll(int top_, int bottom, int n) {
+	top_ = std::max(top_, 0), bottom = std::min(bottom, height);
+	if (stale || n == 0 || top_ >= bottom || std::abs(n) >= bottom - top_) return;
+	if (left != 0 || terminal_columns(out) != width) return;
+	buffer += "\033[" + std::to_string(top + top_ + 1) + ';' + std::to_string(top + bottom) + 'r';
+	buffer += n > 0 ? csi(n, 'T') : csi(-n, 'S');
+	buffer += "\033[r", cursorY = cursorX = -1; // resetting the region homes the cursor
+	scroll_rows(text, width, top_, bottom, n), scroll_rows(fore, width, top_, bottom, n);
+	scroll_rows(back, width, top_, bottom, n), scroll_rows(attrs, width, top_, bottom, n);
+	int exposedTop = n > 0 ? top_ : bottom + n, exposedBottom = n > 0 ? top_ + n : bottom;
+	std::fill(text.begin() + static_cast<size_t>(exposedTop) * width,
+		text.begin() + static_cast<size_t>(exposedBottom) * width, std::string());
+}
+
+// Moves the terminal cursor to the given cell.
+void AnsiScreen::MoveCursor(int y, int x) { MoveTo(y, x); }
+
+// Shows or hides the terminal cursor.
+void AnsiScreen::ShowCursor(bool show) {
+	if (cursorShown == show) return;
+	buffer += show ? "\033[?25h" : "\033[?25l", cursorShown = show;
+}
+
+// Writes everything flushed since the last write to the terminal all at once, as a synchronized
+// update (DEC mode 2026) so the terminal shows the frame as a whole instead of as it arrives.
+// Terminals without synchronized updates ignore the mode like any other unknown private mode.
+void AnsiScreen::Write() {
+	if (buffer.empty()) return;
+	buffer.insert(0, "\033[?2026h"), buffer += "\033[?2026l";
+	count_stat(bytesWritten, buffer.length());
+	fflush(out); // anything written to the terminal before this
+#if !_WIN32
+	// Write the frame with as few system calls as possible, rather than in stdio-sized pieces.
+	for (size_t i = 0; i < buffer.length();) {
+		ssize_t n = write(fileno(out), buffer.data() + i, buffer.length() - i);
+		if (n > 0)
+			i += n;
+		else if (n < 0 && errno != EINTR)
+			break;
+	}
+#else
+	fwrite(buffer.data(), 1, buffer.length(), out), fflush(out);
+#endif
+	buffer.clear();
+}
+
+#if SCINTERM_STATS
+// Render statistics.
+
+RenderCounters *render_counters = nullptr;
+
+// Moves the counts into the given frame statistics, adding them to the given totals, and leaves
+// the counters at zero.
+void RenderCounters::Take(ScintermStats &frame, ScintermStats &total) {
+	auto take = [](std::atomic<unsigned long> &counter, unsigned long &count, unsigned long &sum) {
+		sum += (count = counter.exchange(0));
+	};
+	take(paintMicroseconds, frame.paint_us, total.paint_us);
+	take(rowsPainted, frame.rows_painted, total.rows_painted);
+	take(textMeasures, frame.text_measures, total.text_measures);
+	take(textDraws, frame.text_draws, total.text_draws);
+	take(rectangleFills, frame.rectangle_fills, total.rectangle_fills);
+	take(alphaRectangles, frame.alpha_rectangles, total.alpha_rectangles);
+	take(graphemeClusters, frame.grapheme_clusters, total.grapheme_clusters);
+	take(cellsWritten, frame.cells_written, total.cells_written);
+	take(bytesWritten, frame.bytes_written, total.bytes_written);
+	take(notifications, frame.notifications, total.notifications);
+}
+#endif
 
 // Surface handling.
 
 SurfaceImpl::~SurfaceImpl() noexcept { Release(); }
 
+// Surfaces draw to the cell grid registered for the given window, if any.
 void SurfaceImpl::Init(WindowID wid) {
 	Release();
-	win = _WINDOW(wid);
+	if (auto it = cell_grids.find(wid); it != cell_grids.end()) grid = it->second;
 }
 
 void SurfaceImpl::Init(SurfaceID /*sid*/, WindowID wid) { Init(wid); }
@@ -185,10 +889,13 @@ std::unique_ptr<Surface> SurfaceImpl::AllocatePixMap(int /*width*/, int /*height
 
 void SurfaceImpl::SetMode(SurfaceMode /*mode*/) {}
 
-void SurfaceImpl::Release() noexcept { win = nullptr; }
+void SurfaceImpl::Release() noexcept { grid = nullptr; }
 
-int SurfaceImpl::SupportsFeature(Supports /*feature*/) noexcept {
-	return 0; // feature == Supports::ThreadSafeMeasureWidths;
+// Text measurement only looks up constant tables, so it is safe to do on multiple threads. This
+// lets Scintilla split the measurement of a single long line across its layout threads. Separate
+// lines are still laid out one after another.
+int SurfaceImpl::SupportsFeature(Supports feature) noexcept {
+	return feature == Supports::ThreadSafeMeasureWidths;
 }
 
 bool SurfaceImpl::Initialised() { return true; }
@@ -209,12 +916,14 @@ void SurfaceImpl::PolyLine(const Point * /*pts*/, size_t /*npts*/, Stroke /*stro
 // Only called for CallTip arrows and INDIC_POINT[CHARACTER]. Assume the former. Line markers
 // normally drawn as polygons are handled in `DrawLineMarker()`.
 void SurfaceImpl::Polygon(const Point *pts, size_t npts, FillStroke fillStroke) {
-	ColourRGBA &back = fillStroke.fill.colour;
-	wattr_set(win, 0, term_color_pair(back, COLOR_WHITE), nullptr); // invert
+	if (!grid) return;
+	ColourRGBA &back = fillStroke.fill.colour; // invert
 	if (pts[0].y < pts[npts - 1].y) // up arrow
-		mvwaddstr(win, static_cast<int>(pts[0].y), static_cast<int>(pts[npts - 1].x - 2), "▲");
+		grid->Put(static_cast<int>(pts[0].y), static_cast<int>(pts[npts - 1].x - 2), "▲", 1, back,
+			WHITE, 0);
 	else if (pts[0].y > pts[npts - 1].y) // down arrow
-		mvwaddstr(win, static_cast<int>(pts[0].y - 2), static_cast<int>(pts[npts - 1].x - 2), "▼");
+		grid->Put(static_cast<int>(pts[0].y - 2), static_cast<int>(pts[npts - 1].x - 2), "▼", 1, back,
+			WHITE, 0);
 }
 
 // Never called. Line markers normally drawn as rectangles are handled in `DrawLineMarker()`.
@@ -228,23 +937,25 @@ void SurfaceImpl::RectangleFrame(PRectangle /*rc*/, Stroke /*stroke*/) {}
 // some cases however, it can be determined that whitespace is being drawn. If so, draw it
 // appropriately instead of clearing the given portion of the screen.
 void SurfaceImpl::FillRectangle(PRectangle rc, Fill fill) {
-	if (!win) {
+	count_stat(rectangleFills, 1);
+	if (!grid) {
 		// Drawing to a pixmap, probably the fold margin. Record the color for a later fill.
 		pixmapColor = fill.colour;
 		return;
 	}
-	wattr_set(win, 0, term_color_pair(COLOR_WHITE, fill.colour), nullptr);
+	ColourRGBA fore = WHITE, back = fill.colour;
 	chtype ch = ' ';
 	if (fabs(rc.left - static_cast<int>(rc.left)) > 0.1) {
 		// If rc.left is a fractional value (e.g. 4.5) then whitespace dots are being drawn. Draw
 		// them appropriately.
 		// TODO: set color to vs.whitespaceColours.fore and back.
-		wcolor_set(win, term_color_pair(COLOR_BLACK, COLOR_BLACK), nullptr);
+		fore = BLACK, back = BLACK;
 		rc.right = static_cast<int>(rc.right), ch = ACS_BULLET | A_BOLD;
 	}
+	auto left = static_cast<int>(std::max(rc.left, clip.left));
+	auto right = static_cast<int>(ceil(rc.right));
 	for (int y = static_cast<int>(rc.top); y < rc.bottom; y++)
-		for (int x = static_cast<int>(std::max(rc.left, clip.left)); x < rc.right; x++)
-			mvwaddch(win, y, x, ch);
+		grid->Fill(y, left, right, ch, fore, back);
 }
 
 // Note: special alignment to pixel boundaries is not needed.
@@ -260,21 +971,24 @@ void SurfaceImpl::FillRectangle(PRectangle rc, Surface &surfacePattern) {
 // `DrawLineMarker()`.
 void SurfaceImpl::RoundedRectangle(PRectangle /*rc*/, FillStroke /*fillStroke*/) {}
 
-// Drawing alpha rectangles is not fully supported.
-// Instead, fills the background color of the given rectangle with the fill color, emulating
-// INDIC_STRAIGHTBOX with no transparency.
-// Called to draw INDIC_ROUNDBOX and INDIC_STRAIGHTBOX indicators, text blobs, and translucent
-// line states and selections.
-// Does not draw INDIC_FULLBOX correctly.
+// Composites the fill color over the background color of the given rectangle's cells, leaving
+// their text and foreground colors intact. Terminals with too few colors to show translucency
+// get the fill color as-is.
+// Called to draw INDIC_ROUNDBOX, INDIC_STRAIGHTBOX, and INDIC_FULLBOX indicators, text blobs,
+// and translucent line states and selections. Since those rectangles are inset by a pixel or so
+// on a line that is only one cell high, a rectangle that covers no whole row is drawn on the
+// row nearest its middle.
 void SurfaceImpl::AlphaRectangle(PRectangle rc, XYPOSITION /*cornerSize*/, FillStroke fillStroke) {
+	count_stat(alphaRectangles, 1);
+	if (!grid) return;
 	ColourRGBA &fill = fillStroke.fill.colour;
-	for (int x = static_cast<int>(std::max(rc.left, clip.left)), y = static_cast<int>(rc.top - 1);
-			 x < rc.right; x++) {
-		attr_t attrs = mvwinch(win, y, x) & A_ATTRIBUTES;
-		short pair = PAIR_NUMBER(attrs), fore = COLOR_WHITE, unused;
-		if (pair > 0) pair_content(pair, &fore, &unused);
-		mvwchgat(win, y, x, 1, attrs, term_color_pair(fore, fill), nullptr);
-	}
+	bool blend = translucent_colors() && fill.GetAlpha() < 0xFF;
+	int top = static_cast<int>(rc.top), bottom = static_cast<int>(rc.bottom);
+	if (bottom <= top) top = (top + bottom - 1) / 2, bottom = top + 1;
+	for (int y = top; y < bottom; y++)
+		for (int x = static_cast<int>(std::max(rc.left, clip.left)); x < rc.right; x++)
+			grid->SetBack(
+				y, x, blend ? grid->Back(y, x).MixedWith(fill, fill.GetAlphaComponent()) : fill.Opaque());
 }
 
 void SurfaceImpl::GradientRectangle(
@@ -294,57 +1008,224 @@ void SurfaceImpl::Stadium(PRectangle /*rc*/, FillStroke /*fillStroke*/, Ends /*e
 // buffering is enabled. Since the latter is not supported, assume the former.
 void SurfaceImpl::Copy(PRectangle rc, Point /*from*/, Surface & /*surfaceSource*/) {
 	// TODO: handle indent guide highlighting.
-	if (rc.left - 1 < clip.left) return;
-	wattr_set(win, 0, term_color_pair(COLOR_BLACK, COLOR_BLACK), nullptr);
-	mvwaddch(win, static_cast<int>(rc.top), static_cast<int>(rc.left - 1), '|' | A_BOLD);
+	if (!grid || rc.left - 1 < clip.left) return;
+	grid->Put(static_cast<int>(rc.top), static_cast<int>(rc.left - 1), '|' | A_BOLD, BLACK, BLACK);
 }
 
 std::unique_ptr<IScreenLineLayout> SurfaceImpl::Layout(const IScreenLine * /*screenLine*/) {
 	return nullptr;
 }
 
-#if _WIN32
-#define wcwidth(_) 1 // TODO: http://www.cl.cam.ac.uk/~mgk25/ucs/wcwidth.c
+namespace {
+
+constexpr char32_t tableEnd = 0x40000; // code points past the table are classified directly
+constexpr int blockBits = 7, blockSize = 1 << blockBits, blockCount = tableEnd / blockSize;
+constexpr size_t rangeCount = std::size(cellClassRanges);
+
+// Returns the number of table blocks that contain more than one class of code point.
+// Ranges of the same class are never adjacent, so a block is uniform if it does not intersect
+// a range or if a single range covers it.
+constexpr int mixed_block_count() {
+	int count = 0;
+	for (size_t b = 0, r = 0; b < blockCount; b++) {
+		char32_t first = b * blockSize, last = first + blockSize - 1;
+		while (r < rangeCount && cellClassRanges[r].last < first) r++;
+		if (r < rangeCount && cellClassRanges[r].first <= last &&
+			(cellClassRanges[r].first > first || cellClassRanges[r].last < last))
+			count++;
+	}
+	return count;
+}
+
+// Two-stage lookup table of code point classes, built from `cellClassRanges` at compile time.
+// Each block of code points indexes a row of classes packed two per byte. The first
+// `CellClass::Control + 1` rows are shared by uniform blocks, one per class.
+constexpr int uniformRows = static_cast<int>(CellClass::Control) + 1;
+constexpr int rowCount = uniformRows + mixed_block_count();
+static_assert(rowCount <= 256, "row indices must fit in a byte");
+
+struct CellClassTable {
+	unsigned char blocks[blockCount] = {};
+	unsigned char rows[rowCount][blockSize / 2] = {};
+};
+
+constexpr CellClassTable build_cell_class_table() {
+	CellClassTable table;
+	for (int row = 0; row < uniformRows; row++)
+		for (int i = 0; i < blockSize / 2; i++) table.rows[row][i] = row | row << 4;
+	int mixed = uniformRows;
+	for (size_t b = 0, r = 0; b < blockCount; b++) {
+		char32_t first = b * blockSize, last = first + blockSize - 1;
+		while (r < rangeCount && cellClassRanges[r].last < first) r++;
+		if (r == rangeCount || cellClassRanges[r].first > last) continue; // Narrow (row 0)
+		if (cellClassRanges[r].first <= first && cellClassRanges[r].last >= last) {
+			table.blocks[b] = static_cast<unsigned char>(cellClassRanges[r].cellClass);
+			continue;
+		}
+		table.blocks[b] = mixed;
+		for (size_t i = r; i < rangeCount && cellClassRanges[i].first <= last; i++)
+			for (char32_t ch = std::max(first, cellClassRanges[i].first);
+					 ch <= std::min(last, cellClassRanges[i].last); ch++)
+				table.rows[mixed][(ch - first) / 2] |= static_cast<int>(cellClassRanges[i].cellClass)
+					<< (ch % 2 * 4);
+		mixed++;
+	}
+	return table;
+}
+
+constexpr CellClassTable cellClassTable = build_cell_class_table();
+
+// The number of cells taken up by each class of code point.
+constexpr int cellWidths[] = {1, 2, 0, 0, 1, 1, 2, 1};
+
+} // namespace
+
+/**
+ * Returns the class of the given code point for measuring it.
+ * This is independent of the current locale.
+ */
+CellClass cell_class(char32_t ch) noexcept {
+	if (ch >= tableEnd) return ch >= 0xE0000 && ch <= 0xE0FFF ? CellClass::Extend : CellClass::Narrow;
+	int packed = cellClassTable.rows[cellClassTable.blocks[ch >> blockBits]][ch % blockSize / 2];
+	return static_cast<CellClass>(packed >> (ch % 2 * 4) & 0xF);
+}
+
+namespace {
+
+bool is_pictographic(CellClass cls) noexcept {
+	return cls == CellClass::Pictographic || cls == CellClass::PictographicWide;
+}
+
+} // namespace
+
+/**
+ * Returns the number of bytes in the grapheme cluster at the start of the given UTF-8 text,
+ * and stores the number of columns used to display that cluster in *width*.
+ * A cluster is a character followed by any combining marks and variation selectors, a pair
+ * of regional indicators (a flag), or a sequence of pictographs joined by zero width joiners.
+ * Invalid UTF-8 bytes are single columns on their own.
+ * @param text The text that contains the grapheme cluster to measure.
+ * @param width Variable to store the cluster's width in.
+ */
+size_t grapheme_cluster(std::string_view text, int &width) {
+	count_stat(graphemeClusters, 1);
+	CellClass base = CellClass::Control, prev = base;
+	size_t i = 0;
+	for (int n = 0; i < text.length(); n++) {
+		int utf8 = UTF8Classify(text.data() + i, text.length() - i);
+		if (utf8 & UTF8MaskInvalid) {
+			if (i == 0) i++, width = 1;
+			break;
+		}
+		char32_t ch = UnicodeFromUTF8(reinterpret_cast<const unsigned char *>(text.data() + i));
+		CellClass cls = cell_class(ch);
+		if (n == 0)
+			base = cls, width = cellWidths[static_cast<int>(cls)];
+		else if (base == CellClass::Control)
+			break;
+		else if (cls == CellClass::Extend) {
+			if (ch == 0xFE0F && base == CellClass::Pictographic) width = 2; // emoji presentation
+		} else if (cls == CellClass::RegionalIndicator && base == cls && n == 1)
+			width = 2; // flag
+		else if (cls != CellClass::ZWJ &&
+			!(is_pictographic(cls) && prev == CellClass::ZWJ && is_pictographic(base)))
+			break;
+		prev = cls, i += utf8 & UTF8MaskWidth;
+	}
+	return i;
+}
+
+/**
+ * Returns the number of leading ASCII bytes in the given string.
+ * When SIMD instructions are available, 32- or 16-byte blocks are classified at once.
+ * @param s The string to scan.
+ * @param len The length of *s*.
+ */
+size_t ascii_span(const char *s, size_t len) {
+	size_t i = 0;
+#if __AVX2__
+	for (; i + 32 <= len; i += 32)
+		if (int mask = _mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i))))
+			return i + __builtin_ctz(mask);
+#endif
+#if __SSE2__
+	for (; i + 16 <= len; i += 16)
+		if (int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i))))
+			return i + __builtin_ctz(mask);
 #endif
+	for (uint64_t block; i + 8 <= len; i += 8)
+		if (memcpy(&block, s + i, 8), block & 0x8080808080808080) break;
+	while (i < len && !(s[i] & 0x80)) i++;
+	return i;
+}
 
 /**
- * Returns the number of columns used to display the first UTF-8 character in `s`, taking
- * into account zero-width combining characters.
- * @param s The string that contains the first UTF-8 character to display.
+ * Returns the number of columns used to display the given UTF-8 text.
+ * ASCII runs have a width of 1 per byte; only multibyte grapheme clusters are measured.
  */
-int grapheme_width(const char *s) {
-	wchar_t wch;
-	if (mbtowc(&wch, s, MB_CUR_MAX) < 1) return 1;
-	int width = wcwidth(wch);
-	return width >= 0 ? width : 1;
+int text_width(std::string_view text) {
+	int width = 0;
+	for (size_t i = 0; i < text.length();) {
+		size_t ascii = ascii_span(text.data() + i, text.length() - i);
+		i += ascii, width += static_cast<int>(ascii);
+		if (i == text.length()) break;
+		int cluster_width;
+		i += grapheme_cluster(text.substr(i), cluster_width), width += cluster_width;
+	}
+	return width;
 }
 
-void SurfaceImpl::DrawTextNoClip(PRectangle rc, const Font *font_, XYPOSITION /*ybase*/,
-	std::string_view text, ColourRGBA fore, ColourRGBA back) {
+/**
+ * Returns the longest part of the start of the given UTF-8 text that fits in the given number
+ * of columns.
+ */
+std::string_view clip_width(std::string_view text, int columns) {
+	size_t i = 0;
+	for (int width = 0; i < text.length();) {
+		int cluster_width = 1;
+		size_t len = text[i] & 0x80 ? grapheme_cluster(text.substr(i), cluster_width) : 1;
+		if (width + cluster_width > columns) break;
+		i += len, width += cluster_width;
+	}
+	return text.substr(0, i);
+}
+
+// Draws the given text into the grid, one grapheme cluster per cell (or two for wide clusters),
+// at the columns measured for them. If *back* is not given, each cell keeps its background color.
+// Text left of the clip rectangle (e.g. margin text) and right of the window is not drawn,
+// and the visible part of a wide character cut off by the clip rectangle is blanked.
+void SurfaceImpl::DrawCells(PRectangle rc, const Font *font_, std::string_view text,
+	ColourRGBA fore, std::optional<ColourRGBA> back) {
+	count_stat(textDraws, 1);
+	if (!grid) return;
 	attr_t attrs = dynamic_cast<const FontImpl *>(font_)->attrs;
-	wattr_set(win, attrs, term_color_pair(fore, back), nullptr);
-	if (rc.left < clip.left) {
-		// Do not overwrite margin text.
-		auto clip_chars = static_cast<int>(clip.left - rc.left);
-		size_t offset = 0;
-		for (int chars = 0; offset < text.length(); offset++) {
-			if (!UTF8IsTrailByte(static_cast<unsigned char>(text[offset])))
-				chars += grapheme_width(text.data() + offset);
-			if (chars > clip_chars) break;
+	int y = static_cast<int>(rc.top), x = static_cast<int>(rc.left);
+	int left = static_cast<int>(clip.left), right = grid->Width();
+	auto put = [&](int col, std::string_view cluster, int width) {
+		grid->Put(y, col, cluster, width, fore, back ? *back : grid->Back(y, col), attrs);
+	};
+	for (size_t i = 0; i < text.length() && x < right;) {
+		if (size_t ascii = ascii_span(text.data() + i, text.length() - i)) {
+			for (size_t end = i + ascii; i < end && x < right; i++, x++)
+				if (x >= left) put(x, text.substr(i, 1), 1);
+			continue;
 		}
-		text.remove_prefix(offset);
-		rc.left = clip.left;
-	}
-	// Do not write beyond right window boundary.
-	int clip_chars = getmaxx(win) - static_cast<int>(rc.left);
-	size_t bytes = 0;
-	for (int chars = 0; bytes < text.length(); bytes++) {
-		if (!UTF8IsTrailByte(static_cast<unsigned char>(text[bytes])))
-			chars += grapheme_width(text.data() + bytes);
-		if (chars > clip_chars) break;
+		int width;
+		size_t len = grapheme_cluster(text.substr(i), width);
+		if (x + width > right) break;
+		if (width == 0) {
+			if (x > left) grid->Combine(y, x - 1, text.substr(i, len)); // attach to the previous cell
+		} else if (x >= left)
+			put(x, text.substr(i, len), width);
+		else
+			for (int col = left; col < x + width; col++) put(col, " ", 1);
+		i += len, x += width;
 	}
-	mvwaddnstr(win, static_cast<int>(rc.top), static_cast<int>(rc.left), text.data(),
-		static_cast<int>(std::min(text.length(), bytes)));
+}
+
+void SurfaceImpl::DrawTextNoClip(PRectangle rc, const Font *font_, XYPOSITION /*ybase*/,
+	std::string_view text, ColourRGBA fore, ColourRGBA back) {
+	DrawCells(rc, font_, text, fore, back);
 }
 
 // Called for drawing the caret, text blobs, and `MarkerSymbol::Character` line markers.
@@ -359,30 +1240,29 @@ void SurfaceImpl::DrawTextClipped(PRectangle rc, const Font *font_, XYPOSITION y
 
 // Called for drawing CallTip text and two-phase buffer text.
 void SurfaceImpl::DrawTextTransparent(
-	PRectangle rc, const Font *font_, XYPOSITION ybase, std::string_view text, ColourRGBA fore) {
-	if (static_cast<int>(rc.top) > getmaxy(win) - 1) return;
-	auto left = static_cast<int>(rc.left);
-	attr_t attrs = left >= clip.left ? mvwinch(win, static_cast<int>(rc.top), left) : 0;
-	short pair = PAIR_NUMBER(attrs), unused, back = COLOR_BLACK;
-	if (pair > 0 && !isCallTip) pair_content(pair, &unused, &back);
-	DrawTextNoClip(rc, font_, ybase, text, fore, SCI_COLORS[back]);
+	PRectangle rc, const Font *font_, XYPOSITION /*ybase*/, std::string_view text, ColourRGBA fore) {
+	DrawCells(rc, font_, text, fore, std::nullopt);
 }
 
-// Curses characters always have a width of 1 if they are not UTF-8 trailing bytes.
+// ASCII characters always have a width of 1, and are measured without looking up their class.
+// All bytes of a grapheme cluster are positioned at the end of that cluster.
 void SurfaceImpl::MeasureWidths(
 	const Font * /*font_*/, std::string_view text, XYPOSITION *positions) {
-	for (size_t i = 0, j = 0; i < text.length(); i++) {
-		if (!UTF8IsTrailByte(static_cast<unsigned char>(text[i]))) j += grapheme_width(text.data() + i);
-		positions[i] = static_cast<XYPOSITION>(j);
+	count_stat(textMeasures, 1);
+	int x = 0;
+	for (size_t i = 0; i < text.length();) {
+		for (size_t end = i + ascii_span(text.data() + i, text.length() - i); i < end; i++)
+			positions[i] = static_cast<XYPOSITION>(++x);
+		if (i == text.length()) break;
+		int width;
+		size_t end = i + grapheme_cluster(text.substr(i), width);
+		for (x += width; i < end; i++) positions[i] = static_cast<XYPOSITION>(x);
 	}
 }
 
 XYPOSITION SurfaceImpl::WidthText(const Font * /*font_*/, std::string_view text) {
-	int width = 0;
-	for (size_t i = 0; i < text.length(); i++)
-		if (!UTF8IsTrailByte(static_cast<unsigned char>(text[i])))
-			width += grapheme_width(text.data() + i);
-	return width;
+	count_stat(textMeasures, 1);
+	return text_width(text);
 }
 
 void SurfaceImpl::DrawTextNoClipUTF8(PRectangle rc, const Font *font_, XYPOSITION ybase,
@@ -431,36 +1311,38 @@ void SurfaceImpl::FlushDrawing() {} // N/A
 void SurfaceImpl::DrawLineMarker(
 	const PRectangle &rcWhole, const Font *fontForCharacter, int /*tFold*/, const void *data) {
 	// TODO: handle fold marker highlighting.
+	if (!grid) return;
 	auto marker = reinterpret_cast<const LineMarker *>(data);
-	wattr_set(win, 0, term_color_pair(marker->fore, marker->back), nullptr);
 	int top = static_cast<int>(rcWhole.top), left = static_cast<int>(rcWhole.left);
+	auto glyph = [&](const char *s) { grid->Put(top, left, s, 1, marker->fore, marker->back, 0); };
+	auto acs = [&](chtype ch) { grid->Put(top, left, ch, marker->fore, marker->back); };
 	switch (marker->markType) {
-	case MarkerSymbol::Circle: mvwaddstr(win, top, left, "●"); return;
+	case MarkerSymbol::Circle: glyph("●"); return;
 	case MarkerSymbol::SmallRect:
-	case MarkerSymbol::RoundRect: mvwaddstr(win, top, left, "■"); return;
-	case MarkerSymbol::Arrow: mvwaddstr(win, top, left, "►"); return;
-	case MarkerSymbol::ShortArrow: mvwaddstr(win, top, left, "→"); return;
-	case MarkerSymbol::ArrowDown: mvwaddstr(win, top, left, "▼"); return;
-	case MarkerSymbol::Minus: mvwaddch(win, top, left, '-'); return;
+	case MarkerSymbol::RoundRect: glyph("■"); return;
+	case MarkerSymbol::Arrow: glyph("►"); return;
+	case MarkerSymbol::ShortArrow: glyph("→"); return;
+	case MarkerSymbol::ArrowDown: glyph("▼"); return;
+	case MarkerSymbol::Minus: glyph("-"); return;
 	case MarkerSymbol::BoxMinus:
-	case MarkerSymbol::BoxMinusConnected: mvwaddstr(win, top, left, "⊟"); return;
+	case MarkerSymbol::BoxMinusConnected: glyph("⊟"); return;
 	case MarkerSymbol::CircleMinus:
-	case MarkerSymbol::CircleMinusConnected: mvwaddstr(win, top, left, "⊖"); return;
-	case MarkerSymbol::Plus: mvwaddch(win, top, left, '+'); return;
+	case MarkerSymbol::CircleMinusConnected: glyph("⊖"); return;
+	case MarkerSymbol::Plus: glyph("+"); return;
 	case MarkerSymbol::BoxPlus:
-	case MarkerSymbol::BoxPlusConnected: mvwaddstr(win, top, left, "⊞"); return;
+	case MarkerSymbol::BoxPlusConnected: glyph("⊞"); return;
 	case MarkerSymbol::CirclePlus:
-	case MarkerSymbol::CirclePlusConnected: mvwaddstr(win, top, left, "⊕"); return;
-	case MarkerSymbol::VLine: mvwaddch(win, top, left, ACS_VLINE); return;
+	case MarkerSymbol::CirclePlusConnected: glyph("⊕"); return;
+	case MarkerSymbol::VLine: acs(ACS_VLINE); return;
 	case MarkerSymbol::LCorner:
-	case MarkerSymbol::LCornerCurve: mvwaddch(win, top, left, ACS_LLCORNER); return;
+	case MarkerSymbol::LCornerCurve: acs(ACS_LLCORNER); return;
 	case MarkerSymbol::TCorner:
-	case MarkerSymbol::TCornerCurve: mvwaddch(win, top, left, ACS_LTEE); return;
-	case MarkerSymbol::DotDotDot: mvwaddstr(win, top, left, "…"); return;
-	case MarkerSymbol::Arrows: mvwaddstr(win, top, left, "»"); return;
+	case MarkerSymbol::TCornerCurve: acs(ACS_LTEE); return;
+	case MarkerSymbol::DotDotDot: glyph("…"); return;
+	case MarkerSymbol::Arrows: glyph("»"); return;
 	case MarkerSymbol::FullRect: FillRectangle(rcWhole, marker->back); return;
-	case MarkerSymbol::LeftRect: mvwaddstr(win, top, left, "▌"); return;
-	case MarkerSymbol::Bookmark: mvwaddstr(win, top, left, "Σ"); return;
+	case MarkerSymbol::LeftRect: glyph("▌"); return;
+	case MarkerSymbol::Bookmark: glyph("Σ"); return;
 	default: break; // prevent warning
 	}
 	if (marker->markType >= MarkerSymbol::Character) {
@@ -474,25 +1356,109 @@ void SurfaceImpl::DrawLineMarker(
 
 // Draws the text representation of a wrap marker.
 void SurfaceImpl::DrawWrapMarker(PRectangle rcPlace, bool isEndMarker, ColourRGBA wrapColour) {
-	wattr_set(win, 0, term_color_pair(wrapColour, COLOR_BLACK), nullptr);
-	mvwaddstr(
-		win, static_cast<int>(rcPlace.top), static_cast<int>(rcPlace.left), isEndMarker ? "↩" : "↪");
+	if (!grid) return;
+	grid->Put(static_cast<int>(rcPlace.top), static_cast<int>(rcPlace.left), isEndMarker ? "↩" : "↪",
+		1, wrapColour, BLACK, 0);
 }
 
 // Draws the text representation of a tab arrow.
 void SurfaceImpl::DrawTabArrow(PRectangle rcTab, const ViewStyle &vsDraw) {
 	// TODO: set color to vs.whitespaceColours.fore and back.
-	wattr_set(win, 0, term_color_pair(COLOR_BLACK, COLOR_BLACK), nullptr);
+	if (!grid) return;
+	auto top = static_cast<int>(rcTab.top);
 	for (int i = static_cast<int>(std::max(rcTab.left - 1, clip.left)); i < rcTab.right; i++)
-		mvwaddch(win, static_cast<int>(rcTab.top), i, '-' | A_BOLD);
-	char tail = vsDraw.tabDrawMode == TabDrawMode::LongArrow ? '>' : '-';
-	mvwaddch(win, static_cast<int>(rcTab.top), static_cast<int>(rcTab.right), tail | A_BOLD);
+		grid->Put(top, i, '-' | A_BOLD, BLACK, BLACK);
+	chtype tail = vsDraw.tabDrawMode == TabDrawMode::LongArrow ? '>' : '-';
+	grid->Put(top, static_cast<int>(rcTab.right), tail | A_BOLD, BLACK, BLACK);
 }
 
 std::unique_ptr<Surface> Surface::Allocate(Technology /*technology*/) {
 	return std::make_unique<SurfaceImpl>();
 }
 
+// Damage handling.
+
+namespace {
+
+std::map<WindowID, DamageTracker *> damage_trackers; // trackers for repaintable windows
+
+} // namespace
+
+// Resizing implies the entire window needs to be repainted.
+void DamageTracker::Resize(int height, int width_) {
+	rows.assign(std::max(height, 0), std::make_pair(0, 0));
+	width = std::max(width_, 0);
+	AddAll();
+}
+
+void DamageTracker::Add(PRectangle rc) {
+	int top = std::max(static_cast<int>(floor(rc.top)), 0);
+	int bottom = std::min(static_cast<int>(ceil(rc.bottom)), static_cast<int>(rows.size()));
+	int left = std::max(static_cast<int>(floor(rc.left)), 0);
+	int right = std::min(static_cast<int>(ceil(rc.right)), width);
+	if (top >= bottom || left >= right) return;
+	for (int y = top; y < bottom; y++) {
+		auto &[l, r] = rows[y];
+		if (l < r)
+			l = std::min(l, left), r = std::max(r, right);
+		else
+			l = left, r = right;
+	}
+	damaged = true;
+}
+
+// Moves the damage in the [top, bottom) rows along with those rows when they are scrolled down
+// by *n* rows (up if *n* is negative), and damages the rows scrolled into view. Damage is also
+// kept where it was, since it may have been added after the scroll.
+void DamageTracker::Scroll(int top, int bottom, int n) {
+	top = std::max(top, 0), bottom = std::min(bottom, static_cast<int>(rows.size()));
+	if (n == 0 || top >= bottom) return;
+	std::vector<std::pair<int, int>> moved(rows.begin() + top, rows.begin() + bottom);
+	for (int y = top; y < bottom; y++) {
+		if (int from = y - n; from < top || from >= bottom)
+			Add(PRectangle(0, y, width, y + 1));
+		else if (auto [l, r] = moved[from - top]; l < r)
+			Add(PRectangle(l, y, r, y + 1));
+	}
+}
+
+void DamageTracker::AddAll() {
+	std::fill(rows.begin(), rows.end(), std::make_pair(0, width));
+	damaged = !rows.empty() && width > 0;
+}
+
+// Returns runs of consecutive damaged rows as rectangles spanning the union of each run's
+// damaged columns, and resets the tracker.
+std::vector<PRectangle> DamageTracker::Take() {
+	std::vector<PRectangle> areas;
+	if (!damaged) return areas;
+	for (int y = 0; y < static_cast<int>(rows.size()); y++) {
+		auto &[l, r] = rows[y];
+		if (l >= r) continue;
+		if (!areas.empty() && areas.back().bottom == y) {
+			PRectangle &rc = areas.back();
+			rc.left = std::min(rc.left, static_cast<XYPOSITION>(l));
+			rc.right = std::max(rc.right, static_cast<XYPOSITION>(r));
+			rc.bottom = y + 1;
+		} else
+			areas.push_back(PRectangle(l, y, r, y + 1));
+		l = r = 0;
+	}
+	damaged = false;
+	return areas;
+}
+
+/**
+ * Registers the given damage tracker to receive invalidated areas of the given window.
+ * Passing `nullptr` unregisters any existing tracker.
+ */
+void register_damage_tracker(WindowID wid, DamageTracker *tracker) {
+	if (tracker)
+		damage_trackers[wid] = tracker;
+	else
+		damage_trackers.erase(wid);
+}
+
 // Window handling.
 
 Window::~Window() noexcept {}
@@ -504,7 +1470,7 @@ Window::~Window() noexcept {}
 // It is important to note that even though `ScintillaCurses::wMain` is a Window, its `Destroy()`
 // function is never called, hence why `scintilla_delete()` is the complement to `scintilla_new()`.
 void Window::Destroy() noexcept {
-	if (wid) delwin(_WINDOW(wid));
+	if (wid) delwin(_WINDOW(wid)), damage_trackers.erase(wid);
 	wid = nullptr;
 }
 
@@ -512,12 +1478,15 @@ void Window::Destroy() noexcept {
 // curses. Therefore, this function should always return the window bounds to ensure all of it
 // is painted.
 PRectangle Window::GetPosition() const {
+	if (CellGrid *grid = headless_grid(wid)) return PRectangle(0, 0, grid->Width(), grid->Height());
 	int maxx = wid ? getmaxx(_WINDOW(wid)) : 0;
 	int maxy = wid ? getmaxy(_WINDOW(wid)) : 0;
 	return PRectangle(0, 0, maxx, maxy);
 }
 
+// Popups of headless windows are never created, so they are never positioned.
 void Window::SetPositionRelative(PRectangle rc, const Window *relativeTo) {
+	if (!wid || headless_grid(relativeTo->GetID())) return;
 	int begx = 0, begy = 0, x = 0, y = 0;
 	// Determine the relative position.
 	getbegyx(_WINDOW(relativeTo->GetID()), begy, begx);
@@ -547,31 +1516,35 @@ PRectangle Window::GetClientPosition() const { return GetPosition(); }
 
 void Window::Show(bool /*show*/) {} // TODO: ?
 
-void Window::InvalidateAll() {} // TODO: notify repaint?
+void Window::InvalidateAll() {
+	if (auto it = damage_trackers.find(wid); it != damage_trackers.end()) it->second->AddAll();
+}
 
-void Window::InvalidateRectangle(PRectangle /*rc*/) {} // TODO: notify repaint?
+void Window::InvalidateRectangle(PRectangle rc) {
+	if (auto it = damage_trackers.find(wid); it != damage_trackers.end()) it->second->Add(rc);
+}
 
 void Window::SetCursor(Cursor /*curs*/) {}
 
 PRectangle Window::GetMonitorRect(Point /*pt*/) { return GetPosition(); }
 
-ListBoxImpl::ListBoxImpl() {
-	list.reserve(10);
-	ClearRegisteredImages();
-}
+ListBoxImpl::ListBoxImpl() { ClearRegisteredImages(); }
 
 void ListBoxImpl::SetFont(const Font * /*font*/) {}
 
-void ListBoxImpl::Create(Window & /*parent*/, int /*ctrlID*/, Point /*location_*/,
+// Headless windows have no curses screen to show list boxes on, so their list boxes keep track
+// of items and selections without a window.
+void ListBoxImpl::Create(Window &parent, int /*ctrlID*/, Point /*location_*/,
 	int /*lineHeight_*/, bool /*unicodeMode_*/, Technology /*technology_*/) {
-	wid = newwin(1, 1, 0, 0); // will be resized as items are added
+	if (!headless_grid(parent.GetID())) wid = newwin(1, 1, 0, 0); // resized as items are added
+	drawnSelection.reset();
 }
 
 void ListBoxImpl::SetAverageCharWidth(int /*width*/) {} // N/A
 
 void ListBoxImpl::SetVisibleRows(int rows) {
-	height = rows;
-	wresize(_WINDOW(wid), height + 2, width + 2);
+	height = rows, drawnSelection.reset();
+	if (wid) wresize(_WINDOW(wid), height + 2, width + 2);
 }
 
 int ListBoxImpl::GetVisibleRows() const { return height; }
@@ -583,60 +1556,192 @@ PRectangle ListBoxImpl::GetDesiredRect() {
 int ListBoxImpl::CaretFromEdge() { return 2; } // shift border and type character over
 
 void ListBoxImpl::Clear() noexcept {
-	list.clear();
-	width = 0;
+	arena.clear(), items.clear(), sorted.clear(), fuzzyQuery.clear(), fuzzyMatches.clear();
+	shown.clear(), width = 0, drawnSelection.reset();
+}
+
+// Adds the given item to the end of the list without resizing the window, and returns the
+// number of cells it needs, including its type character.
+int ListBoxImpl::Add(std::string_view value, int type) {
+	items.push_back(Item{arena.length(), value.length(), type >= 0 && type <= IMAGE_MAX ? type : -1});
+	arena += value;
+	sorted.clear(), fuzzyQuery.clear(), fuzzyMatches.clear(), shown.clear();
+	drawnSelection.reset();
+	return text_width(value) + 1;
 }
 
 void ListBoxImpl::Append(char *s, int type) {
-	if (type >= 0 && type <= IMAGE_MAX) {
-		char *chtype = types[type];
-		list.push_back(std::string(chtype, strlen(chtype)) + s);
-	} else
-		list.push_back(std::string(" ") + s);
-	int len = static_cast<int>(strlen(s)); // TODO: UTF-8 awareness?
-	if (width < len + 1) {
-		width = len + 1; // include type character len
-		wresize(_WINDOW(wid), height + 2, width + 2);
+	if (int itemWidth = Add(s, type); width < itemWidth) {
+		width = itemWidth;
+		if (wid) wresize(_WINDOW(wid), height + 2, width + 2);
 	}
 }
 
-int ListBoxImpl::Length() { return static_cast<int>(list.size()); }
+// Lists filtered by `Filter()` only have the items shown.
+int ListBoxImpl::Length() {
+	if (!shown.empty()) return static_cast<int>(shown.size());
+	return fetch ? fetchCount : static_cast<int>(items.size());
+}
+
+// Returns the item that is the given one of those shown.
+int ListBoxImpl::Shown(int n) const noexcept { return shown.empty() ? n : shown[n]; }
 
+// Items are drawn with the selected one in the middle, if possible. The window keeps what was
+// drawn, so if the same items would be drawn again (e.g. when redrawing the list over the
+// Scintilla window), only the highlight moves, if at all.
 void ListBoxImpl::Select(int n) {
+	selection = n;
+	if (!wid) return;
 	WINDOW *w = _WINDOW(wid);
-	wclear(w);
-	box(w, '|', '-');
-	auto len = static_cast<int>(list.size());
+	int len = Length();
 	int s = n - height / 2;
 	if (s + height > len) s = len - height;
 	if (s < 0) s = 0;
+	if (drawnSelection && drawnTop == s) {
+		if (*drawnSelection != n) {
+			if (int row = *drawnSelection - s; row >= 0 && row < height)
+				mvwchgat(w, row + 1, 2, width - 1, A_NORMAL, 0, nullptr);
+			if (int row = n - s; row >= 0 && row < height)
+				mvwchgat(w, row + 1, 2, width - 1, A_REVERSE, 0, nullptr);
+		}
+		drawnSelection = n;
+		wmove(w, n - s + 1, 1), touchwin(w), wnoutrefresh(w); // show over the Scintilla window
+		return;
+	}
+	drawnSelection = n, drawnTop = s;
+	werase(w);
+	box(w, '|', '-');
 	for (int i = s; i < s + height && i < len; i++) {
-		mvwaddstr(w, i - s + 1, 1, list.at(i).c_str());
+		int itemType;
+		std::string_view value = Value(Shown(i), &itemType);
+		const char *type = itemType >= 0 ? types[itemType] : " ";
+		if (fetch) value = clip_width(value, width - 1); // unmeasured items may be too wide
+		mvwaddstr(w, i - s + 1, 1, type), waddnstr(w, value.data(), static_cast<int>(value.length()));
+		count_stat(bytesWritten, strlen(type) + value.length());
 		if (i == n) mvwchgat(w, i - s + 1, 2, width - 1, A_REVERSE, 0, nullptr);
 	}
 	wmove(w, n - s + 1, 1); // place cursor on selected line
 	wnoutrefresh(w);
-	selection = n;
 }
 
 int ListBoxImpl::GetSelection() { return selection; }
 
-// The type is the first (UTF-8) character, so start searching at the second one.
+// Returns the value of the given item, and stores its type in *type* if it is given.
+// The values of virtual lists are only valid until the next item is fetched.
+std::string_view ListBoxImpl::Value(int n, int *type) const {
+	if (fetch) {
+		int itemType = -1;
+		const char *text = fetch(n, &itemType, fetchData);
+		if (type) *type = itemType >= 0 && itemType <= IMAGE_MAX ? itemType : -1;
+		return text ? text : "";
+	}
+	if (type) *type = items[n].type;
+	return std::string_view(arena).substr(items[n].start, items[n].length);
+}
+
+// Binary searches an index of items sorted by value, which is built on the first search after
+// the list changes, and returns the first item in the list with the prefix. When the list is
+// sorted, as autocompletion lists normally are, that is the first one found; otherwise it is
+// the earliest of the items found.
+// Virtual lists are sorted, so they are searched directly. Filtered lists are searched as a
+// whole.
 int ListBoxImpl::Find(const char *prefix) {
-	size_t len = strlen(prefix);
-	for (unsigned int i = 0; i < list.size(); i++) {
-		const char *item = list.at(i).c_str();
-		item += UTF8DrawBytes(reinterpret_cast<const char *>(item), strlen(item));
-		if (strncmp(prefix, item, len) == 0) return i;
+	std::string_view p = prefix;
+	if (fetch) {
+		int lo = 0, hi = fetchCount;
+		while (lo < hi)
+			if (int mid = lo + (hi - lo) / 2; Value(mid) < p)
+				lo = mid + 1;
+			else
+				hi = mid;
+		return lo < fetchCount && Value(lo).substr(0, p.length()) == p ? lo : -1;
+	}
+	if (sorted.size() != items.size()) {
+		sorted.resize(items.size());
+		std::iota(sorted.begin(), sorted.end(), 0);
+		std::stable_sort(
+			sorted.begin(), sorted.end(), [this](int a, int b) { return Value(a) < Value(b); });
+		ordered = std::is_sorted(sorted.begin(), sorted.end());
 	}
-	return -1;
+	auto first = std::lower_bound(sorted.begin(), sorted.end(), p,
+		[this](int n, std::string_view value) { return Value(n) < value; });
+	auto last = std::partition_point(
+		first, sorted.end(), [this, p](int n) { return Value(n).substr(0, p.length()) == p; });
+	if (first == last) return -1;
+	return ordered ? *first : *std::min_element(first, last);
+}
+
+namespace {
+
+// Returns how well the given query matches the given value as a subsequence, ignoring case,
+// if it matches at all.
+// Each matched character scores, more so if it continues a run of matches, starts the value or
+// a word in it (e.g. after '_' or at a capital letter), or matches case. Skipped characters
+// cost a little, so tighter matches rank higher.
+std::optional<int> fuzzy_score(std::string_view query, std::string_view value) {
+	auto lower = [](char ch) { return tolower(static_cast<unsigned char>(ch)); };
+	int score = 0, run = 0;
+	for (size_t i = 0, j = 0; i < query.length(); i++, j++) {
+		size_t start = j;
+		while (j < value.length() && lower(value[j]) != lower(query[i])) j++;
+		if (j == value.length()) return std::nullopt;
+		run = (j == start && i > 0) ? run + 1 : 0;
+		score += 1 + 2 * run - static_cast<int>(std::min<size_t>(j - start, 3));
+		auto ch = static_cast<unsigned char>(value[j]);
+		auto prev = j > 0 ? static_cast<unsigned char>(value[j - 1]) : '\0';
+		if (j == 0 || (!isalnum(prev) && isalnum(ch)) || (isupper(ch) && islower(prev))) score += 3;
+		if (value[j] == query[i]) score++;
+	}
+	return score;
+}
+
+} // namespace
+
+// Returns the items that match the given query as a subsequence of their values, best match
+// first. Ties go to the shorter item, and then to the earlier one.
+// Only items that matched the previous query are scored when the query extends it (e.g. as
+// the user types), since only they can match.
+std::vector<int> ListBoxImpl::FindFuzzy(std::string_view query) {
+	if (query.empty()) return (fuzzyQuery.clear(), fuzzyMatches.clear(), std::vector<int>{});
+	bool narrowing = !fuzzyQuery.empty() && query.substr(0, fuzzyQuery.length()) == fuzzyQuery;
+	struct Match {
+		int score, length, n;
+	};
+	std::vector<Match> ranked;
+	auto score = [&](int n) {
+		std::string_view value = Value(n);
+		if (auto itemScore = fuzzy_score(query, value))
+			ranked.push_back(Match{*itemScore, static_cast<int>(value.length()), n});
+	};
+	if (narrowing)
+		for (int n : fuzzyMatches) score(n);
+	else
+		for (int n = 0, len = fetch ? fetchCount : static_cast<int>(items.size()); n < len; n++)
+			score(n);
+	std::vector<int> matches;
+	matches.reserve(ranked.size());
+	for (const Match &match : ranked) matches.push_back(match.n); // in list order
+	fuzzyQuery = query, fuzzyMatches = matches;
+	std::sort(ranked.begin(), ranked.end(), [](const Match &a, const Match &b) {
+		if (a.score != b.score) return a.score > b.score;
+		return a.length != b.length ? a.length < b.length : a.n < b.n;
+	});
+	for (size_t i = 0; i < ranked.size(); i++) matches[i] = ranked[i].n;
+	return matches;
+}
+
+// Shows only the given items, in the given order, or all of them if there are none.
+// Items are then numbered by their position in *matches*, as if the list only had them.
+void ListBoxImpl::Filter(std::vector<int> matches) {
+	if (shown.empty() && matches.empty()) return;
+	shown = std::move(matches), selection = 0, drawnSelection.reset();
 }
 
-// The type is the first (UTF-8) character, so return the string after it.
 std::string ListBoxImpl::GetValue(int n) {
-	const char *item = list.at(n).c_str();
-	item += UTF8DrawBytes(reinterpret_cast<const char *>(item), strlen(item));
-	return item;
+	n = Shown(n);
+	if (fetch) return std::string(Value(n));
+	const Item &item = items.at(n);
+	return arena.substr(item.start, item.length);
 }
 
 // Register the first UTF-8 character as the type (e.g. "*", "+", or "■").
@@ -645,7 +1750,7 @@ void ListBoxImpl::RegisterImage(int type, const char *xpm_data) {
 	if (type < 0 || type > IMAGE_MAX) return;
 	int len = UTF8DrawBytes(reinterpret_cast<const char *>(xpm_data), strlen(xpm_data));
 	for (int i = 0; i < len; i++) types[type][i] = xpm_data[i];
-	types[type][len] = '\0';
+	types[type][len] = '\0', drawnSelection.reset();
 }
 
 void ListBoxImpl::RegisterRGBAImage(
@@ -654,31 +1759,54 @@ void ListBoxImpl::RegisterRGBAImage(
 // Clear back to ' ' (space).
 void ListBoxImpl::ClearRegisteredImages() {
 	for (int i = 0; i <= IMAGE_MAX; i++) types[i][0] = ' ', types[i][1] = '\0';
+	drawnSelection.reset();
 }
 
 void ListBoxImpl::SetDelegate(IListBoxDelegate *lbDelegate) { delegate = lbDelegate; }
 
+// Adds items straight from the given text into the arena, and resizes the window only once.
+// Virtual lists ignore the text, and are only as wide as their first few items.
 void ListBoxImpl::SetList(const char *listText, char separator, char typesep) {
 	Clear();
-	size_t len = strlen(listText);
-	char *text = new char[len + 1];
-	if (!text) return;
-	memcpy(text, listText, len + 1);
-	char *word = text, *type = nullptr;
-	for (size_t i = 0; i <= len; i++) {
-		if (text[i] == separator || i == len) {
-			text[i] = '\0';
-			if (type) *type = '\0';
-			Append(word, type ? atoi(type + 1) : -1);
-			word = text + i + 1, type = nullptr;
-		} else if (text[i] == typesep)
-			type = text + i;
-	}
-	delete[] text;
+	if (fetch) {
+		for (int n = 0; n < std::min(fetchCount, 100); n++)
+			width = std::max(width, text_width(Value(n)) + 1);
+		if (wid) wresize(_WINDOW(wid), height + 2, width + 2);
+		return;
+	}
+	std::string_view text = listText;
+	arena.reserve(text.length());
+	int listWidth = 0;
+	for (size_t start = 0; start <= text.length();) {
+		size_t end = std::min(text.find(separator, start), text.length());
+		std::string_view item = text.substr(start, end - start);
+		int type = -1;
+		if (size_t i = item.rfind(typesep); i != std::string_view::npos) {
+			type = 0; // like `atoi()`, for types that are not numbers
+			std::from_chars(item.data() + i + 1, item.data() + item.length(), type);
+			item = item.substr(0, i);
+		}
+		listWidth = std::max(listWidth, Add(item, type));
+		start = end + 1;
+	}
+	width = listWidth;
+	if (wid) wresize(_WINDOW(wid), height + 2, width + 2);
 }
 
 void ListBoxImpl::SetOptions(ListOptions /*options_*/) {}
 
+/**
+ * Makes the list a virtual one whose items are fetched as needed by the given function, or
+ * makes it a normal list again if *fetch_* is `nullptr`.
+ * The function returns the text of the given item, which must be valid until it is called
+ * again, and stores its type. Items must be sorted.
+ */
+void ListBoxImpl::SetSource(int count, const char *(*fetch_)(int, int *, void *), void *userdata) {
+	fetch = fetch_, fetchData = userdata, fetchCount = fetch ? std::max(count, 0) : 0;
+	sorted.clear(), fuzzyQuery.clear(), fuzzyMatches.clear(), shown.clear();
+	drawnSelection.reset();
+}
+
 ListBox::ListBox() noexcept = default;
 
 ListBox::~ListBox() noexcept = default;
@@ -18,11 +18,16 @@ public:
 	attr_t attrs = 0;
 };
 
+class CellGrid;
+
 class SurfaceImpl : public Surface {
-	WINDOW *win = nullptr; // curses window to draw on
+	CellGrid *grid = nullptr; // cell grid of the curses window to draw on
 	PRectangle clip;
 	ColourRGBA pixmapColor;
 
+	void DrawCells(PRectangle rc, const Font *font_, std::string_view text, ColourRGBA fore,
+		std::optional<ColourRGBA> back);
+
 public:
 	SurfaceImpl() = default;
 	~SurfaceImpl() noexcept override;
@@ -93,15 +98,32 @@ public:
 		const PRectangle &rcWhole, const Font *fontForCharacter, int tFold, const void *data);
 	void DrawWrapMarker(PRectangle rcPlace, bool isEndMarker, ColourRGBA wrapColour);
 	void DrawTabArrow(PRectangle rcTab, const ViewStyle &vsDraw);
-
-	bool isCallTip = false;
 };
 
 class ListBoxImpl : public ListBox {
 	int height = 5, width = 10;
-	std::vector<std::string> list;
+	struct Item {
+		size_t start, length; // the item's value in `arena`
+		int type; // the item's registered type, or -1
+	};
+	std::string arena; // the values of all items, one after another
+	std::vector<Item> items;
+	const char *(*fetch)(int n, int *type, void *userdata) = nullptr; // source of a virtual list
+	void *fetchData = nullptr; // userdata for `fetch`
+	int fetchCount = 0; // the number of items in a virtual list
 	char types[IMAGE_MAX + 1][5]; // UTF-8 character plus terminating '\0' instead of an image
 	int selection = 0;
+	std::optional<int> drawnSelection; // selection drawn in the window, if its rows are current
+	int drawnTop = 0; // the first item drawn in the window
+	std::vector<int> sorted; // item indices sorted by value, built by `Find()` when needed
+	bool ordered = true; // whether the items are already sorted by value
+	std::string fuzzyQuery; // the last query passed to `FindFuzzy()`
+	std::vector<int> fuzzyMatches; // items that matched it
+	std::vector<int> shown; // the items shown, if not all of them
+
+	std::string_view Value(int n, int *type = nullptr) const;
+	int Shown(int n) const noexcept;
+	int Add(std::string_view value, int type);
 
 public:
 	IListBoxDelegate *delegate = nullptr;
@@ -123,6 +145,9 @@ public:
 	void Select(int n) override;
 	int GetSelection() override;
 	int Find(const char *prefix) override;
+	std::vector<int> FindFuzzy(std::string_view query);
+	void Filter(std::vector<int> matches);
+	void SetSource(int count, const char *(*fetch_)(int, int *, void *), void *userdata);
 	std::string GetValue(int n) override;
 	void RegisterImage(int type, const char *xpm_data) override;
 	void RegisterRGBAImage(
@@ -133,9 +158,139 @@ public:
 	void SetOptions(ListOptions options_) override;
 };
 
+/**
+ * Tracks the areas of a curses window that need to be repainted.
+ * Scintilla reports the areas it invalidates via `Window::InvalidateRectangle()` and
+ * `Window::InvalidateAll()`, which record them in the tracker registered for that window.
+ * Areas are tracked as a range of damaged columns per row.
+ */
+class DamageTracker {
+	std::vector<std::pair<int, int>> rows; // damaged [left, right) columns per row
+	int width = 0;
+	bool damaged = false;
+
+public:
+	void Resize(int height, int width_);
+	void Add(PRectangle rc);
+	void AddAll();
+	void Scroll(int top, int bottom, int n);
+	bool Empty() const noexcept { return !damaged; }
+	std::vector<PRectangle> Take();
+};
+
+void register_damage_tracker(WindowID wid, DamageTracker *tracker);
+
+/**
+ * A grid of terminal cells that surfaces draw into instead of drawing to a curses window.
+ * Each cell's text, colors, and attributes are kept in separate planes so that overlays like
+ * indicators, translucent selections, and transparent text composite with what was drawn
+ * underneath without reading the window back. Changed cells are written to the window a row
+ * at a time by `Flush()`.
+ */
+class CellGrid {
+	int height = 0, width = 0;
+	std::vector<std::string> text; // grapheme cluster per cell; empty right of a wide cluster
+	std::vector<ColourRGBA> fore, back;
+	std::vector<attr_t> attrs; // curses attributes per cell, excluding color
+	std::vector<int> shown; // color pair each cell was last written to the window with
+	std::vector<std::pair<int, int>> dirty; // changed [left, right) columns per row
+	std::string run; // buffer for flushing runs of ASCII cells
+
+	void Split(size_t i);
+	void Touch(int y, int left, int right);
+
+public:
+	CellGrid() = default;
+	CellGrid(const CellGrid &) = delete;
+	CellGrid &operator=(const CellGrid &) = delete;
+	~CellGrid();
+
+	void Resize(int height_, int width_);
+	int Height() const noexcept { return height; }
+	int Width() const noexcept { return width; }
+	void Put(int y, int x, std::string_view cluster, int cellWidth, ColourRGBA fore_,
+		ColourRGBA back_, attr_t attrs_);
+	void Put(int y, int x, chtype ch, ColourRGBA fore_, ColourRGBA back_);
+	void Fill(int y, int left, int right, chtype ch, ColourRGBA fore_, ColourRGBA back_);
+	void Combine(int y, int x, std::string_view mark);
+	ColourRGBA Back(int y, int x) const;
+	const std::string *Get(int y, int x, ColourRGBA &fore_, ColourRGBA &back_, attr_t &attrs_) const;
+	void SetBack(int y, int x, ColourRGBA back_);
+	std::pair<int, int> TakeDirty(int y);
+	void Scroll(int top, int bottom, int n);
+	void Flush(WINDOW *win);
+	void Box(WINDOW *win, int pair);
+};
+
+void register_cell_grid(WindowID wid, CellGrid *grid);
+CellGrid *headless_grid(WindowID wid);
+
+/**
+ * A terminal that a cell grid is written to directly with ANSI escape sequences instead of via
+ * curses.
+ * It keeps a front buffer of the cells the terminal is showing, and flushes a grid (the back
+ * buffer) by emitting only what turns one into the other: SGR attribute and color changes,
+ * cursor movements relative to the current position when they are shorter, erasures to the
+ * end of the line, and repeated characters (REP). Flushes and cursor changes are buffered until
+ * `Write()` sends them to the terminal as a single synchronized update.
+ */
+class AnsiScreen {
+	FILE *out; // terminal to write to
+	bool trueColor; // whether to emit 24-bit colors instead of xterm's 256 colors
+	int top, left; // terminal position of the grid's first cell
+	int height = 0, width = 0;
+	std::vector<std::string> text; // front buffer, like `CellGrid`'s
+	std::vector<ColourRGBA> fore, back;
+	std::vector<attr_t> attrs;
+	bool stale = true; // whether the front buffer does not reflect the terminal
+	int cursorY = -1, cursorX = -1; // grid position of the terminal cursor, or -1 if unknown
+	std::optional<attr_t> sgrAttrs; // current SGR attributes, if known
+	ColourRGBA sgrFore, sgrBack; // current SGR colors, if `sgrAttrs` is known
+	int cursorShown = -1; // whether the terminal cursor is shown, or -1 if unknown
+	std::string buffer; // escape sequences and text to write
+
+	void MoveTo(int y, int x);
+	void SetStyle(attr_t attrs_, ColourRGBA fore_, ColourRGBA back_);
+	std::string SGRColor(int base, ColourRGBA color);
+
+public:
+	AnsiScreen(FILE *out_, int top_, int left_, bool trueColor_)
+			: out(out_), trueColor(trueColor_), top(top_), left(left_) {}
+	int Top() const noexcept { return top; }
+	int Left() const noexcept { return left; }
+	void Invalidate() noexcept;
+	void Flush(CellGrid &grid);
+	void Scroll(int top_, int bottom, int n);
+	void MoveCursor(int y, int x);
+	void ShowCursor(bool show);
+	void Write();
+};
+
+#if SCINTERM_STATS
+/**
+ * Rendering counters for a Scintilla window.
+ * Platform code adds to the counters in `render_counters`, which the window points to its own
+ * counters while it is handling calls. Lines may be laid out on multiple threads, so counters
+ * are atomic.
+ */
+struct RenderCounters {
+	std::atomic<unsigned long> paintMicroseconds{0}, rowsPainted{0}, textMeasures{0}, textDraws{0},
+		rectangleFills{0}, alphaRectangles{0}, graphemeClusters{0}, cellsWritten{0},
+		bytesWritten{0}, notifications{0};
+
+	void Take(ScintermStats &frame, ScintermStats &total);
+};
+
+extern RenderCounters *render_counters;
+#endif
+
 void init_colors();
-short term_color(ColourRGBA color);
-short term_color(short color);
+int term_color(ColourRGBA color);
+int term_color(int color);
+bool reserve_color_pairs(int n);
+int color_pair(int fore, int back);
+int pin_color_pair(int fore, int back);
+void term_attr_set(WINDOW *win, attr_t attrs, int pair);
 
 } // namespace Scintilla::Internal
 
@@ -147,22 +302,41 @@ short term_color(short color);
 #define _WINDOW(w) reinterpret_cast<WINDOW *>(w)
 
 /**
- * Returns the curses `COLOR_PAIR` for the given curses foreground and background `COLOR`s.
- * This is used simply to enumerate every possible color combination.
- * Note: only 256 combinations are possible due to curses portability.
- * Note: This references the global curses variable `COLORS` and is not a constant expression.
+ * Returns a curses color pair from the given fore and back colors, creating it if necessary.
+ * @param f Foreground color, either a Scintilla color or curses color.
+ * @param b Background color, either a Scintilla color or curses color.
+ * @return curses color pair suitable for passing to `term_attr_set()`.
+ */
+#define term_color_pair(f, b) color_pair(term_color(f), term_color(b))
+
+/**
+ * Returns a curses color pair for the given curses foreground and background `COLOR`s.
+ * Deprecated: Scinterm no longer defines a fixed pair for every color combination. This now
+ * defines the pair on demand, like `term_color_pair()`, but Scinterm never redefines it, since
+ * the application may be showing it. Applications should instead reserve the pairs they define
+ * themselves with `scintilla_reserve_color_pairs()`. This will be removed in a future release.
+ * Note: Colors must have been initialized, which happens when the first Scintilla window is
+ * refreshed; until then, this returns the default pair (0).
  * @param f The curses foreground `COLOR`.
  * @param b The curses background `COLOR`.
  * @return int number for defining a curses `COLOR_PAIR`.
  */
-#define SCI_COLOR_PAIR(f, b) ((b) * ((COLORS < 16) ? 8 : 16) + (f) + 1)
+#define SCI_COLOR_PAIR(f, b) \
+	Scintilla::Internal::pin_color_pair( \
+		Scintilla::Internal::term_color(f), Scintilla::Internal::term_color(b))
 
 /**
- * Returns a curses color pair from the given fore and back colors.
- * @param f Foreground color, either a Scintilla color or curses color.
- * @param b Background color, either a Scintilla color or curses color.
- * @return curses color pair suitable for calling `COLOR_PAIR()` with.
+ * Adds to the given render counter of the Scintilla window being handled, if any.
+ * This compiles to nothing unless `SCINTERM_STATS` is defined.
+ * @param counter The `RenderCounters` member to add to.
+ * @param n The amount to add.
  */
-#define term_color_pair(f, b) SCI_COLOR_PAIR(term_color(f), term_color(b))
+#if SCINTERM_STATS
+#define count_stat(counter, n) \
+	(render_counters ? void(render_counters->counter.fetch_add(n, std::memory_order_relaxed)) \
+									 : void())
+#else
+#define count_stat(counter, n) void()
+#endif
 
 #endif
@@ -3,18 +3,28 @@
 // UTF-8 characters properly in ncursesw.
 
 #include <cassert>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <cmath>
+#include <climits>
 
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 #include <map>
 #include <set>
 #include <optional>
+#include <tuple>
 #include <algorithm>
+#include <array>
 #include <memory>
+#include <atomic>
 #include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include <curses.h>
 
@@ -81,6 +91,9 @@ void DrawTabArrow(
 	reinterpret_cast<SurfaceImpl *>(surface)->DrawTabArrow(rcTab, vsDraw);
 }
 
+// Colors of scroll bar gutters, and the inverse for scroll bars.
+const ColourRGBA scrollBarFore(0xC0, 0xC0, 0xC0), scrollBarBack(0, 0, 0);
+
 // Uses the given UTF-8 code point to fill the given UTF-8 byte sequence and length.
 // This algorithm was inspired by Paul Evans' libtermkey.
 // (http://www.leonerd.org.uk/code/libtermkey)
@@ -112,23 +125,831 @@ void toutf8(int code, char *s, int *len) {
 		s[0] = 0xFC | (code & 0x01);
 }
 
+// Tracing.
+
+std::mutex trace_mutex; // guards writes to the trace file
+std::atomic<FILE *> trace_file{nullptr}; // Chrome trace event file, if tracing
+std::chrono::steady_clock::time_point trace_start; // time trace event timestamps are relative to
+bool trace_empty = true; // whether or not no events have been written yet
+
+// Stops writing any trace events, terminates the trace file, and then starts writing events to
+// the given file, if any, returning whether or not it could be opened.
+// Events are written as a Chrome trace event JSON array, which chrome://tracing and Perfetto
+// can load even if it was not terminated (e.g. the application crashed).
+bool set_trace_file(const char *path) {
+	std::lock_guard<std::mutex> lock(trace_mutex);
+	if (FILE *f = trace_file.exchange(nullptr)) fputs("\n]\n", f), fclose(f);
+	if (!path) return true;
+	FILE *f = fopen(path, "w");
+	if (!f) return false;
+	fputs("[\n", f);
+	trace_start = std::chrono::steady_clock::now(), trace_empty = true;
+	trace_file = f;
+	return true;
+}
+
+// Starts tracing to the file named by the `SCINTERM_TRACE` environment variable, if it is set,
+// the first time it is called.
+void trace_from_environment() {
+	static bool checked = false;
+	if (checked) return;
+	checked = true;
+	if (const char *path = getenv("SCINTERM_TRACE")) set_trace_file(path);
+}
+
+// Returns a small, stable ID for the calling thread to identify it in trace events.
+int trace_thread_id() {
+	static std::atomic<int> next{1};
+	thread_local int id = next++;
+	return id;
+}
+
+// Records the time from creation to destruction as a trace event if tracing is enabled.
+// Spans nest, so slow frames can be broken down into the calls they were made up of.
+class TraceSpan {
+	const char *name; // `nullptr` if not tracing
+	const char *argName;
+	long arg;
+	std::chrono::steady_clock::time_point start;
+
+public:
+	explicit TraceSpan(const char *name_, const char *argName_ = nullptr, long arg_ = 0)
+			: name(trace_file ? name_ : nullptr), argName(argName_), arg(arg_) {
+		if (name) start = std::chrono::steady_clock::now();
+	}
+	~TraceSpan() {
+		if (!name) return;
+		auto end = std::chrono::steady_clock::now();
+		std::lock_guard<std::mutex> lock(trace_mutex);
+		FILE *f = trace_file;
+		if (!f) return; // tracing stopped
+		using us = std::chrono::duration<double, std::micro>;
+		fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+			trace_empty ? "" : ",\n", name, trace_thread_id(), us(start - trace_start).count(),
+			us(end - start).count());
+		if (argName) fprintf(f, ",\"args\":{\"%s\":%ld}", argName, arg);
+		fputc('}', f), trace_empty = false;
+	}
+};
+
+// Background lexing.
+
+// A copy of part of a document's text that a lexer can style on another thread.
+// The copy starts a little before the text to style and is extended on the main thread as
+// lexing reaches its end, so that no single copy is proportional to the document's size. Text
+// far enough behind the lexer is dropped.
+// The styles, line states, and fold levels a lexer sets are recorded per chunk so they can be
+// published back to the document on the main thread.
+class TextSnapshot : public IDocument {
+	std::string text, styles; // of the document from base to limit
+	Sci_Position base, limit = 0, length; // length is the document's length
+	std::vector<Sci_Position> lineStarts; // built on first use by the lexing thread
+	std::map<Sci_Position, int> lineStates; // known line states, including those set
+	std::vector<int> levels; // fold levels of lines from firstLine on
+	Sci_Position firstLine; // the line base starts
+	int codePage, tabInChars;
+	IDocument *doc; // only for IsDBCSLeadByte(), which reads immutable tables
+	Sci_Position stylingPos = 0;
+
+	char CharAt(Sci_Position position) const {
+		return position >= base && position < limit ? text[position - base] : '\0';
+	}
+	void CopyTo(IDocument *pAccess, Sci_Position end);
+	void BuildLines();
+	void ScanLines(Sci_Position from);
+
+public:
+	// The current chunk's changes.
+	Sci_Position styledStart = 0, styledEnd = 0;
+	std::vector<std::pair<Sci_Position, int>> changedLineStates, changedLevels;
+
+	TextSnapshot(IDocument *pAccess, Sci_Position start, Sci_Position end);
+
+	void Extend(IDocument *pAccess, Sci_Position keepFrom);
+	// Whether or not the copy reaches the end of the document.
+	bool Complete() const noexcept { return limit == length; }
+	Sci_Position Limit() const noexcept { return limit; }
+
+	int SCI_METHOD Version() const override { return dvRelease4; }
+	void SCI_METHOD SetErrorStatus(int /*status*/) override {}
+	Sci_Position SCI_METHOD Length() const override { return length; }
+	void SCI_METHOD GetCharRange(
+		char *buffer, Sci_Position position, Sci_Position len) const override;
+	char SCI_METHOD StyleAt(Sci_Position position) const override;
+	Sci_Position SCI_METHOD LineFromPosition(Sci_Position position) const override;
+	Sci_Position SCI_METHOD LineStart(Sci_Position line) const override;
+	int SCI_METHOD GetLevel(Sci_Position line) const override;
+	int SCI_METHOD SetLevel(Sci_Position line, int level) override;
+	int SCI_METHOD GetLineState(Sci_Position line) const override;
+	int SCI_METHOD SetLineState(Sci_Position line, int state) override;
+	void SCI_METHOD StartStyling(Sci_Position position) override;
+	bool SCI_METHOD SetStyleFor(Sci_Position length, char style) override;
+	bool SCI_METHOD SetStyles(Sci_Position length, const char *styles_) override;
+	// Indicators are not part of the snapshot, so lexers cannot set them in the background.
+	void SCI_METHOD DecorationSetCurrentIndicator(int /*indicator*/) override {}
+	void SCI_METHOD DecorationFillRange(
+		Sci_Position /*position*/, int /*value*/, Sci_Position /*fillLength*/) override {}
+	void SCI_METHOD ChangeLexerState(Sci_Position /*start*/, Sci_Position /*end*/) override {}
+	int SCI_METHOD CodePage() const override { return codePage; }
+	bool SCI_METHOD IsDBCSLeadByte(char ch) const override { return doc->IsDBCSLeadByte(ch); }
+	// The snapshot does not hold the whole document, and Lexilla's lexers do not ask for it.
+	const char *SCI_METHOD BufferPointer() override { return nullptr; }
+	int SCI_METHOD GetLineIndentation(Sci_Position line) override;
+	Sci_Position SCI_METHOD LineEnd(Sci_Position line) const override;
+	Sci_Position SCI_METHOD GetRelativePosition(
+		Sci_Position positionStart, Sci_Position characterOffset) const override;
+	int SCI_METHOD GetCharacterAndWidth(Sci_Position position, Sci_Position *pWidth) const override;
+
+	void StartChunk(Sci_Position start);
+	std::string Styles(Sci_Position start, Sci_Position end) const {
+		return styles.substr(start - base, end - start);
+	}
+};
+
+// How far before the first unstyled position to copy styles, line states, and fold levels
+// from, since lexers may look back at them. Lexed text is kept for as long.
+constexpr Sci_Position snapshotLookBehind = 0x10000;
+// How much text to keep after the chunk being lexed, since lexers may look ahead at it.
+constexpr Sci_Position snapshotLookAhead = 0x4000;
+// How much more text to copy each time lexing reaches the end of the snapshot.
+constexpr Sci_Position snapshotExtension = 0x40000;
+
+// Copies the document's text from a little before *start* to a little after *end*, along with
+// the styles and line states before *start*. This, along with `Extend()`, is the only part of
+// background lexing done on the main thread, and neither copies more than a bounded amount.
+TextSnapshot::TextSnapshot(IDocument *pAccess, Sci_Position start, Sci_Position end)
+		: length(pAccess->Length()), codePage(pAccess->CodePage()), doc(pAccess) {
+	auto document = dynamic_cast<Document *>(pAccess);
+	tabInChars = document ? document->tabInChars : 8;
+	firstLine = pAccess->LineFromPosition(std::max<Sci_Position>(start - snapshotLookBehind, 0));
+	base = limit = pAccess->LineStart(firstLine);
+	CopyTo(pAccess, std::min(std::max(start, end) + snapshotExtension, length));
+	for (Sci_Position pos = base; pos < start; pos++) styles[pos - base] = pAccess->StyleAt(pos);
+	for (Sci_Position line = firstLine, last = pAccess->LineFromPosition(start); line <= last; line++)
+		lineStates[line] = pAccess->GetLineState(line);
+}
+
+// Appends the document's text up to *end*, along with the fold levels of the lines it covers,
+// since folders compare against them.
+void TextSnapshot::CopyTo(IDocument *pAccess, Sci_Position end) {
+	const Sci_Position from = limit;
+	text.resize(end - base), styles.resize(end - base, '\0');
+	pAccess->GetCharRange(text.data() + (from - base), from, end - from);
+	limit = end;
+	for (Sci_Position line = firstLine + static_cast<Sci_Position>(levels.size()),
+										last = pAccess->LineFromPosition(end);
+			 line <= last; line++)
+		levels.push_back(pAccess->GetLevel(line));
+	// A '\r' that ended the previous copy may be followed by a '\n'.
+	if (!lineStarts.empty())
+		ScanLines(from > base && text[from - base - 1] == '\r' ? from - 1 : from);
+}
+
+// Copies more of the document once lexing has caught up to the end of the snapshot, dropping
+// lines before *keepFrom*. The document must not have changed since the snapshot was taken.
+void TextSnapshot::Extend(IDocument *pAccess, Sci_Position keepFrom) {
+	Sci_Position line = LineFromPosition(keepFrom), start = LineStart(line);
+	if (line > firstLine) {
+		text.erase(0, start - base), styles.erase(0, start - base);
+		lineStarts.erase(lineStarts.begin(), lineStarts.begin() + (line - firstLine));
+		levels.erase(levels.begin(), levels.begin() + (line - firstLine));
+		lineStates.erase(lineStates.begin(), lineStates.lower_bound(line));
+		base = start, firstLine = line;
+	}
+	CopyTo(pAccess, std::min(limit + snapshotExtension, length));
+}
+
+void TextSnapshot::BuildLines() {
+	lineStarts.push_back(base);
+	ScanLines(base);
+}
+
+// Records the starts of lines after the given position.
+// Lines end in "\r\n", '\n', or '\r'. A '\r' at the end of the snapshot only ends a line if
+// the document ends there too, since a '\n' may follow it.
+void TextSnapshot::ScanLines(Sci_Position from) {
+	for (Sci_Position pos = from; pos < limit; pos++) {
+		char ch = text[pos - base];
+		if (ch == '\n' || (ch == '\r' && (pos + 1 < limit ? text[pos + 1 - base] != '\n' : Complete())))
+			lineStarts.push_back(pos + 1);
+	}
+}
+
+// Text outside of the snapshot reads as NUL bytes.
+void SCI_METHOD TextSnapshot::GetCharRange(
+	char *buffer, Sci_Position position, Sci_Position len) const {
+	for (Sci_Position i = 0; i < len; i++) buffer[i] = CharAt(position + i);
+}
+
+char SCI_METHOD TextSnapshot::StyleAt(Sci_Position position) const {
+	return position >= base && position < limit ? styles[position - base] : 0;
+}
+
+// Positions before the snapshot are considered to be on its first line.
+Sci_Position SCI_METHOD TextSnapshot::LineFromPosition(Sci_Position position) const {
+	if (lineStarts.empty()) const_cast<TextSnapshot *>(this)->BuildLines();
+	auto it = std::upper_bound(lineStarts.begin(), lineStarts.end(), position);
+	return firstLine + std::max<Sci_Position>(it - lineStarts.begin() - 1, 0);
+}
+
+Sci_Position SCI_METHOD TextSnapshot::LineStart(Sci_Position line) const {
+	if (lineStarts.empty()) const_cast<TextSnapshot *>(this)->BuildLines();
+	line -= firstLine;
+	if (line < 0) return base;
+	return line < static_cast<Sci_Position>(lineStarts.size()) ? lineStarts[line] : limit;
+}
+
+int SCI_METHOD TextSnapshot::GetLevel(Sci_Position line) const {
+	line -= firstLine;
+	if (line < 0 || line >= static_cast<Sci_Position>(levels.size()))
+		return static_cast<int>(FoldLevel::Base);
+	return levels[line];
+}
+
+int SCI_METHOD TextSnapshot::SetLevel(Sci_Position line, int level) {
+	int prev = GetLevel(line);
+	if (line < firstLine || line >= firstLine + static_cast<Sci_Position>(levels.size()))
+		return prev;
+	levels[line - firstLine] = level, changedLevels.emplace_back(line, level);
+	return prev;
+}
+
+int SCI_METHOD TextSnapshot::GetLineState(Sci_Position line) const {
+	auto it = lineStates.find(line);
+	return it != lineStates.end() ? it->second : 0;
+}
+
+int SCI_METHOD TextSnapshot::SetLineState(Sci_Position line, int state) {
+	int prev = GetLineState(line);
+	lineStates[line] = state, changedLineStates.emplace_back(line, state);
+	return prev;
+}
+
+void SCI_METHOD TextSnapshot::StartStyling(Sci_Position position) {
+	stylingPos = position, styledStart = std::min(styledStart, std::max(position, base));
+}
+
+// Styles are only recorded within the snapshot.
+bool SCI_METHOD TextSnapshot::SetStyleFor(Sci_Position len, char style) {
+	if (stylingPos < base) return false;
+	len = std::clamp<Sci_Position>(len, 0, limit - stylingPos);
+	std::fill_n(styles.begin() + (stylingPos - base), len, style);
+	stylingPos += len, styledEnd = std::max(styledEnd, stylingPos);
+	return true;
+}
+
+bool SCI_METHOD TextSnapshot::SetStyles(Sci_Position len, const char *styles_) {
+	if (stylingPos < base) return false;
+	len = std::clamp<Sci_Position>(len, 0, limit - stylingPos);
+	std::copy_n(styles_, len, styles.begin() + (stylingPos - base));
+	stylingPos += len, styledEnd = std::max(styledEnd, stylingPos);
+	return true;
+}
+
+int SCI_METHOD TextSnapshot::GetLineIndentation(Sci_Position line) {
+	int indent = 0;
+	for (Sci_Position pos = LineStart(line), end = LineEnd(line); pos < end; pos++)
+		if (CharAt(pos) == ' ')
+			indent++;
+		else if (CharAt(pos) == '\t')
+			indent = (indent / tabInChars + 1) * tabInChars;
+		else
+			break;
+	return indent;
+}
+
+Sci_Position SCI_METHOD TextSnapshot::LineEnd(Sci_Position line) const {
+	Sci_Position end = LineStart(line + 1);
+	if (line + 1 - firstLine >= static_cast<Sci_Position>(lineStarts.size())) return end; // last
+	if (end > base && CharAt(end - 1) == '\n') end--;
+	if (end > base && CharAt(end - 1) == '\r') end--;
+	return end;
+}
+
+Sci_Position SCI_METHOD TextSnapshot::GetRelativePosition(
+	Sci_Position positionStart, Sci_Position characterOffset) const {
+	Sci_Position pos = positionStart;
+	for (; characterOffset > 0 && pos < Length(); characterOffset--) {
+		Sci_Position width;
+		GetCharacterAndWidth(pos, &width), pos += width;
+	}
+	for (; characterOffset < 0 && pos > 0; characterOffset++) {
+		pos--;
+		if (codePage == SC_CP_UTF8)
+			for (int i = 0; i < 3 && pos > 0 && (CharAt(pos) & 0xC0) == 0x80; i++) pos--;
+		else if (codePage && pos > 0 && IsDBCSLeadByte(CharAt(pos - 1)))
+			pos--;
+	}
+	return characterOffset == 0 ? pos : -1;
+}
+
+// Invalid UTF-8 bytes are reported as singleton surrogates, like `Document` does.
+int SCI_METHOD TextSnapshot::GetCharacterAndWidth(
+	Sci_Position position, Sci_Position *pWidth) const {
+	auto lead = static_cast<unsigned char>(CharAt(position));
+	int ch = lead, width = 1;
+	if (codePage == SC_CP_UTF8 && lead >= 0x80 && position >= base) {
+		const char *s = text.data() + (position - base);
+		int status = UTF8Classify(s, limit - position);
+		if (status & UTF8MaskInvalid)
+			ch = 0xDC80 + lead;
+		else
+			width = status & UTF8MaskWidth,
+			ch = UnicodeFromUTF8(reinterpret_cast<const unsigned char *>(s));
+	} else if (codePage && position + 1 < limit && IsDBCSLeadByte(CharAt(position)))
+		ch = lead << 8 | static_cast<unsigned char>(CharAt(position + 1)), width = 2;
+	if (pWidth) *pWidth = width;
+	return ch;
+}
+
+// Prepares for lexing the chunk that starts at the given position.
+void TextSnapshot::StartChunk(Sci_Position start) {
+	styledStart = styledEnd = stylingPos = start;
+	changedLineStates.clear(), changedLevels.clear();
+}
+
+// Styles, line states, and fold levels a background lexer produced for part of a document.
+struct LexedChunk {
+	Sci_Position start, end, length; // length is the document's length when it was lexed
+	std::string styles;
+	std::vector<std::pair<Sci_Position, int>> lineStates, levels;
+};
+
+bool painting_document(const Document *document);
+
+// Wraps a lexer so that it lexes and folds a snapshot of its document on a worker thread,
+// starting from the first unstyled line, instead of on the main thread while painting.
+// Lexing is sequential, so the lexer works through the document in chunks, stopping at the
+// end of the area that was asked to be styled (normally the end of the view) so that it can be
+// published first, and then continues on to the end of the document.
+// Text changes cancel that work, and the next request for styling restarts it with a new
+// snapshot. Finished chunks are published by `publish_background_lexing()`, which also
+// extends the snapshot when the worker runs out of text.
+// Styling asked for when not painting is done right away on the main thread.
+class BackgroundLexer : public ILexer5 {
+	ILexer5 *lexer;
+	std::mutex lexerMutex; // guards `lexer`, which only one thread may use at a time
+	std::mutex mutex; // guards the following
+	std::condition_variable workAvailable;
+	std::unique_ptr<TextSnapshot> snapshot; // owned by the worker while it is lexing
+	Sci_Position next = 0, priorityEnd = 0; // start of the next chunk, and the end of the view
+	unsigned int generation = 0; // incremented on cancellation
+	bool running = false, finished = false, quit = false;
+	bool starved = false; // the worker needs more of the document's text to continue
+	std::vector<LexedChunk> chunks; // lexed chunks waiting to be published
+	Document *doc = nullptr;
+	std::thread worker;
+
+	void Work();
+
+public:
+	static std::set<BackgroundLexer *> instances;
+
+	BackgroundLexer(ILexer5 *lexer_);
+	virtual ~BackgroundLexer();
+
+	void Cancel();
+	bool Publish();
+	bool IsRunning() noexcept;
+	bool NeedsPublishing() noexcept;
+	Document *GetDocument() const noexcept { return doc; }
+
+	int SCI_METHOD Version() const override { return lvRelease5; }
+	void SCI_METHOD Release() override { delete this; }
+	const char *SCI_METHOD PropertyNames() override;
+	int SCI_METHOD PropertyType(const char *name) override;
+	const char *SCI_METHOD DescribeProperty(const char *name) override;
+	Sci_Position SCI_METHOD PropertySet(const char *key, const char *val) override;
+	const char *SCI_METHOD DescribeWordListSets() override;
+	Sci_Position SCI_METHOD WordListSet(int n, const char *wl) override;
+	void SCI_METHOD Lex(
+		Sci_PositionU startPos, Sci_Position lengthDoc, int initStyle, IDocument *pAccess) override;
+	void SCI_METHOD Fold(Sci_PositionU /*startPos*/, Sci_Position /*lengthDoc*/, int /*initStyle*/,
+		IDocument * /*pAccess*/) override {} // done along with Lex()
+	void *SCI_METHOD PrivateCall(int operation, void *pointer) override;
+	int SCI_METHOD LineEndTypesSupported() override;
+	int SCI_METHOD AllocateSubStyles(int styleBase, int numberStyles) override;
+	int SCI_METHOD SubStylesStart(int styleBase) override;
+	int SCI_METHOD SubStylesLength(int styleBase) override;
+	int SCI_METHOD StyleFromSubStyle(int subStyle) override;
+	int SCI_METHOD PrimaryStyleFromStyle(int style) override;
+	void SCI_METHOD FreeSubStyles() override;
+	void SCI_METHOD SetIdentifiers(int style, const char *identifiers) override;
+	int SCI_METHOD DistanceToSecondaryStyles() override;
+	const char *SCI_METHOD GetSubStyleBases() override;
+	int SCI_METHOD NamedStyles() override;
+	const char *SCI_METHOD NameOfStyle(int style) override;
+	const char *SCI_METHOD TagsOfStyle(int style) override;
+	const char *SCI_METHOD DescriptionOfStyle(int style) override;
+	const char *SCI_METHOD GetName() override;
+	int SCI_METHOD GetIdentifier() override;
+	const char *SCI_METHOD PropertyGet(const char *key) override;
+};
+
+std::set<BackgroundLexer *> BackgroundLexer::instances;
+
+// Lexed chunks are at most this many bytes, so cancellation and calls to the wrapped lexer
+// wait for at most one chunk.
+constexpr Sci_Position backgroundLexChunk = 0x10000;
+
+BackgroundLexer::BackgroundLexer(ILexer5 *lexer_) : lexer(lexer_) {
+	instances.insert(this);
+	worker = std::thread(&BackgroundLexer::Work, this);
+}
+
+BackgroundLexer::~BackgroundLexer() {
+	instances.erase(this);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	workAvailable.notify_one();
+	worker.join();
+	lexer->Release();
+}
+
+// Lexes and folds the snapshot a chunk at a time until it is done or cancelled.
+void BackgroundLexer::Work() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		workAvailable.wait(lock, [this]() { return quit || (running && snapshot && !starved); });
+		if (quit) return;
+		unsigned int gen = generation;
+		std::unique_ptr<TextSnapshot> text = std::move(snapshot);
+		Sci_Position start = next, end = next < priorityEnd ? priorityEnd : start + backgroundLexChunk;
+		lock.unlock();
+		end = text->LineStart(text->LineFromPosition(std::min(end, start + backgroundLexChunk)) + 1);
+		if (!text->Complete() && end > text->Limit() - snapshotLookAhead)
+			end = text->LineStart(text->LineFromPosition(text->Limit() - snapshotLookAhead));
+		if (end <= start) {
+			// Wait for the main thread to copy more text.
+			lock.lock();
+			if (gen == generation && !quit) snapshot = std::move(text), starved = true;
+			continue;
+		}
+		text->StartChunk(start);
+		int initStyle = start > 0 ? static_cast<unsigned char>(text->StyleAt(start - 1)) : 0;
+		{
+			TraceSpan span("BackgroundLex", "bytes", static_cast<long>(end - start));
+			std::lock_guard<std::mutex> lexerLock(lexerMutex);
+			lexer->Lex(start, end - start, initStyle, text.get());
+			lexer->Fold(start, end - start, initStyle, text.get());
+		}
+		Sci_Position styledStart = std::min(text->styledStart, start);
+		LexedChunk chunk{styledStart, end, text->Length(), text->Styles(styledStart, end),
+			std::move(text->changedLineStates), std::move(text->changedLevels)};
+		lock.lock();
+		if (gen != generation || quit) continue; // cancelled while lexing; the snapshot is stale
+		chunks.push_back(std::move(chunk)), next = end;
+		if (end < text->Length())
+			snapshot = std::move(text);
+		else
+			finished = true;
+	}
+}
+
+// Stops lexing the current snapshot and discards anything not yet published.
+void BackgroundLexer::Cancel() {
+	std::lock_guard<std::mutex> lock(mutex);
+	generation++, running = false, starved = false, snapshot.reset(), chunks.clear();
+}
+
+// Applies lexed chunks to the document on the main thread, returning whether or not any were
+// applied, and then gives the worker more text if it needs it. If the document no longer
+// matches the snapshot those chunks came from (e.g. it was modified without a view to report
+// it), they are discarded and lexing is cancelled.
+bool BackgroundLexer::Publish() {
+	std::vector<LexedChunk> ready;
+	unsigned int gen;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (chunks.empty() && !starved) return false;
+		ready.swap(chunks), gen = generation;
+	}
+	for (const LexedChunk &chunk : ready) {
+		if (chunk.start > doc->GetEndStyled() || chunk.length != doc->Length())
+			return (Cancel(), false);
+		for (const auto &[line, state] : chunk.lineStates) doc->SetLineState(line, state);
+		for (const auto &[line, level] : chunk.levels) doc->SetLevel(line, level);
+		doc->StartStyling(chunk.start);
+		doc->SetStyles(chunk.styles.length(), chunk.styles.data());
+		std::lock_guard<std::mutex> lock(mutex);
+		if (generation != gen) return true; // cancelled by a modification made in a notification
+	}
+	std::unique_lock<std::mutex> lock(mutex);
+	if (starved && generation == gen) {
+		if (snapshot->Length() != doc->Length()) {
+			lock.unlock();
+			return (Cancel(), !ready.empty());
+		}
+		TraceSpan span("ExtendSnapshot");
+		snapshot->Extend(doc, next - snapshotLookBehind), starved = false;
+		workAvailable.notify_one();
+	}
+	if (finished && chunks.empty()) running = false;
+	return !ready.empty();
+}
+
+bool BackgroundLexer::IsRunning() noexcept {
+	std::lock_guard<std::mutex> lock(mutex);
+	return running;
+}
+
+// Whether or not there are lexed chunks to publish or the worker is waiting for more text.
+bool BackgroundLexer::NeedsPublishing() noexcept {
+	std::lock_guard<std::mutex> lock(mutex);
+	return !chunks.empty() || starved;
+}
+
+// Called while a window paints the document to style up to the end of the view. Starts lexing
+// in the background unless that is already underway, and returns immediately.
+// Otherwise, anything that asks for styled text (e.g. `SCI_COLOURISE` or brace matching) needs
+// it right away, so this cancels any lexing in the background and lexes with the wrapped lexer.
+void SCI_METHOD BackgroundLexer::Lex(
+	Sci_PositionU startPos, Sci_Position lengthDoc, int initStyle, IDocument *pAccess) {
+	if (!painting_document(dynamic_cast<Document *>(pAccess))) {
+		Cancel();
+		TraceSpan span("Lex", "bytes", static_cast<long>(lengthDoc));
+		std::lock_guard<std::mutex> lexerLock(lexerMutex);
+		lexer->Lex(startPos, lengthDoc, initStyle, pAccess);
+		lexer->Fold(startPos, lengthDoc, initStyle, pAccess);
+		return;
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+	if (running) {
+		priorityEnd = std::max<Sci_Position>(priorityEnd, startPos + lengthDoc);
+		return;
+	}
+	doc = dynamic_cast<Document *>(pAccess);
+	if (!doc) return;
+	generation++, chunks.clear();
+	snapshot = std::make_unique<TextSnapshot>(pAccess, startPos, startPos + lengthDoc);
+	next = startPos, priorityEnd = startPos + lengthDoc, running = true, finished = false;
+	starved = false;
+	workAvailable.notify_one();
+}
+
+const char *SCI_METHOD BackgroundLexer::PropertyNames() {
+	std::lock_guard<std::mutex> lock(lexerMutex);
+	return lexer->PropertyNames();
+}
+
+int SCI_METHOD BackgroundLexer::PropertyType(const char *name) {
+	std::lock_guard<std::mutex> lock(lexerMutex);
+	return lexer->PropertyType(name);
+}
+
+const char *SCI_METHOD BackgroundLexer::DescribeProperty(const char *name) {
+	std::lock_guard<std::mutex> lock(lexerMutex);
+	return lexer->DescribeProperty(name);
+}
+
+// Changing a property may change styles, so any lexing in progress is stale.
+Sci_Position SCI_METHOD BackgroundLexer::PropertySet(const char *key, const char *val) {
+	Sci_Position pos;
+	{
+		std::lock_guard<std::mutex> lock(lexerMutex);
+		pos = lexer->PropertySet(key, val);
+	}
+	if (pos >= 0) Cancel();
+	return pos;
+}
+
+const char *SCI_METHOD BackgroundLexer::DescribeWordListSets() {
+	std::lock_guard<std::mutex> lock(lexerMutex);
+	return lexer->DescribeWordListSets();
+}
+
+// Changing a word list may change styles, so any lexing in progress is stale.
+Sci_Position SCI_METHOD BackgroundLexer::WordListSet(int n, const char *wl) {
+	Sci_Position pos;
+	{
+		std::lock_guard<std::mutex> lock(lexerMutex);
+		pos = lexer->WordListSet(n, wl);
+	}
+	if (pos >= 0) Cancel();
+	return pos;
+}
+
+void *SCI_METHOD BackgroundLexer::PrivateCall(int operation, void *pointer) {
+	std::lock_guard<std::mutex> lock(lexerMutex);
+	return lexer->PrivateCall(operation, pointer);
+}
+
+int SCI_METHOD BackgroundLexer::LineEndTypesSupported() {
+	std::lock_guard<std::mutex> lock(lexerMutex);
+	return lexer->LineEndTypesSupported();
+}
+
+int SCI_METHOD BackgroundLexer::AllocateSubStyles(int styleBase, int numberStyles) {
+	Cancel();
+	std::lock_guard<std::mutex> lock(lexerMutex);
+	return lexer->AllocateSubStyles(styleBase, numberStyles);
+}
+
+int SCI_METHOD BackgroundLexer::SubStylesStart(int styleBase) {
+	std::lock_guard<std::mutex> lock(lexerMutex);
+	return lexer->SubStylesStart(styleBase);
+}
+
+int SCI_METHOD BackgroundLexer::SubStylesLength(int styleBase) {
+	std::lock_guard<std::mutex> lock(lexerMutex);
+	return lexer->SubStylesLength(styleBase);
+}
+
+int SCI_METHOD BackgroundLexer::StyleFromSubStyle(int subStyle) {
+	std::lock_guard<std::mutex> lock(lexerMutex);
+	return lexer->StyleFromSubStyle(subStyle);
+}
+
+int SCI_METHOD BackgroundLexer::PrimaryStyleFromStyle(int style) {
+	std::lock_guard<std::mutex> lock(lexerMutex);
+	return lexer->PrimaryStyleFromStyle(style);
+}
+
+void SCI_METHOD BackgroundLexer::FreeSubStyles() {
+	Cancel();
+	std::lock_guard<std::mutex> lock(lexerMutex);
+	lexer->FreeSubStyles();
+}
+
+void SCI_METHOD BackgroundLexer::SetIdentifiers(int style, const char *identifiers) {
+	Cancel();
+	std::lock_guard<std::mutex> lock(lexerMutex);
+	lexer->SetIdentifiers(style, identifiers);
+}
+
+int SCI_METHOD BackgroundLexer::DistanceToSecondaryStyles() {
+	std::lock_guard<std::mutex> lock(lexerMutex);
+	return lexer->DistanceToSecondaryStyles();
+}
+
+const char *SCI_METHOD BackgroundLexer::GetSubStyleBases() {
+	std::lock_guard<std::mutex> lock(lexerMutex);
+	return lexer->GetSubStyleBases();
+}
+
+int SCI_METHOD BackgroundLexer::NamedStyles() {
+	std::lock_guard<std::mutex> lock(lexerMutex);
+	return lexer->NamedStyles();
+}
+
+const char *SCI_METHOD BackgroundLexer::NameOfStyle(int style) {
+	std::lock_guard<std::mutex> lock(lexerMutex);
+	return lexer->NameOfStyle(style);
+}
+
+const char *SCI_METHOD BackgroundLexer::TagsOfStyle(int style) {
+	std::lock_guard<std::mutex> lock(lexerMutex);
+	return lexer->TagsOfStyle(style);
+}
+
+const char *SCI_METHOD BackgroundLexer::DescriptionOfStyle(int style) {
+	std::lock_guard<std::mutex> lock(lexerMutex);
+	return lexer->DescriptionOfStyle(style);
+}
+
+const char *SCI_METHOD BackgroundLexer::GetName() {
+	std::lock_guard<std::mutex> lock(lexerMutex);
+	return lexer->GetName();
+}
+
+int SCI_METHOD BackgroundLexer::GetIdentifier() {
+	std::lock_guard<std::mutex> lock(lexerMutex);
+	return lexer->GetIdentifier();
+}
+
+const char *SCI_METHOD BackgroundLexer::PropertyGet(const char *key) {
+	std::lock_guard<std::mutex> lock(lexerMutex);
+	return lexer->PropertyGet(key);
+}
+
+// Cancels background lexing of the given document, whose text changed.
+void cancel_background_lexing(Document *document) {
+	for (BackgroundLexer *lexer : BackgroundLexer::instances)
+		if (lexer->GetDocument() == document) lexer->Cancel();
+}
+
+// Publishes the chunks lexed in the background for all documents, returning whether or not
+// there were any.
+// Publishing notifies the application, which might replace lexers, so only publish for lexers
+// that still exist.
+bool publish_background_lexing() {
+	bool published = false;
+	std::vector<BackgroundLexer *> lexers(
+		BackgroundLexer::instances.begin(), BackgroundLexer::instances.end());
+	for (BackgroundLexer *lexer : lexers)
+		if (BackgroundLexer::instances.count(lexer) && lexer->Publish()) published = true;
+	return published;
+}
+
+// Returns `0` if there are lexed chunks to publish or snapshots to extend, the number of
+// milliseconds to wait before checking again if lexing is underway, or `-1` if there is no
+// background lexing.
+int background_lexing_timeout() {
+	int timeout = -1;
+	for (BackgroundLexer *lexer : BackgroundLexer::instances)
+		if (lexer->NeedsPublishing())
+			return 0;
+		else if (lexer->IsRunning())
+			timeout = 10;
+	return timeout;
+}
+
+// Render statistics.
+
+#if SCINTERM_STATS
+// Points `render_counters` at the given counters while a Scintilla window handles a call,
+// restoring the previous counters afterwards since calls can nest (e.g. a notification callback
+// that sends messages to another window).
+class StatsScope {
+	RenderCounters *previous;
+
+public:
+	explicit StatsScope(RenderCounters &counters) : previous(render_counters) {
+		render_counters = &counters;
+	}
+	~StatsScope() { render_counters = previous; }
+};
+
+// Like `StatsScope`, but also times a refresh and then ends the frame.
+class FrameScope : StatsScope {
+	RenderCounters &counters;
+	ScintermStats &frame, &total;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+public:
+	FrameScope(RenderCounters &counters_, ScintermStats &frame_, ScintermStats &total_)
+			: StatsScope(counters_), counters(counters_), frame(frame_), total(total_) {}
+	~FrameScope() {
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		counters.paintMicroseconds +=
+			std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+		counters.Take(frame, total);
+	}
+};
+
+#define STATS_SCOPE StatsScope statsScope(counters)
+#define FRAME_SCOPE FrameScope frameScope(counters, frameStats, totalStats)
+#else
+#define STATS_SCOPE
+#define FRAME_SCOPE
+#endif
+
+// Clipboard.
+
+// The clipboard shared by all Scintilla windows.
+// Its text is never modified, only replaced by copies and cuts, so pastes and borrowers can hold
+// onto a snapshot without copying it.
+std::shared_ptr<const SelectionText> clipboard = std::make_shared<SelectionText>();
+
 } // namespace
 
 class ScintillaCurses : public ScintillaBase {
 	std::unique_ptr<Surface> sur; // window surface to draw on
+	bool painting = false; // in `PaintArea()`, but not in a notification sent while painting
+	bool headless; // whether to draw only into the cell grid, without a curses window
+	std::unique_ptr<AnsiScreen> ansi; // terminal a headless window writes its grid to, if any
 	int width = 0, height = 0; // window dimensions
 	void (*callback)(void *, int, SCNotification *, void *); // SCNotification cb
 	void *userdata; // userdata for SCNotification callbacks
 	int scrollBarVPos, scrollBarHPos; // positions of the scroll bars
 	int scrollBarHeight = 1, scrollBarWidth = 1; // scroll bar height and width
-	SelectionText clipboard; // current clipboard text
+	// Positions, sizes, and window sizes of the scroll bars as last drawn, if they still are.
+	std::optional<std::array<int, 4>> drawnVScrollBar, drawnHScrollBar;
+	std::shared_ptr<const SelectionText> borrowedClipboard; // clipboard text lent out, if any
 	bool capturedMouse; // whether or not the mouse is currently captured
 	unsigned int autoCompleteLastClickTime; // last click time in the AC box
 	bool draggingVScrollBar, draggingHScrollBar; // a scrollbar is being dragged
 	int dragOffset; // the distance to the position of the scrollbar being dragged
+	DamageTracker damage; // areas of the window that need to be repainted
+	CellGrid grid, callTipGrid; // cells painted for the window and call tip, respectively
+	DamageTracker callTipDamage; // whether the call tip needs to be repainted
+	std::unique_ptr<Surface> callTipSur; // call tip surface to draw on
+	bool popupShown = false; // an autocompletion list or call tip was shown last refresh
+	struct Ticker {
+		std::chrono::steady_clock::time_point due;
+		std::chrono::milliseconds interval{0}; // zero if not running
+	};
+	std::array<Ticker, static_cast<size_t>(TickReason::platform) + 1> tickers; // per TickReason
+	std::chrono::steady_clock::duration frameInterval{0}; // minimum time between frames, if any
+	std::chrono::steady_clock::time_point lastFrame; // when the last frame was painted
+	bool framePending = false; // a refresh was put off until the next frame is due
+	int wheelLines = 0, wheelColumns = 0; // mouse wheel scrolling not yet done
+	std::optional<std::tuple<int, int, KeyMod>> pendingMove; // mouse move not yet handled
+	bool fuzzyAutoComplete = false; // whether to fall back on fuzzy matching autocompletions
+	bool typingRun = false; // a run of typed text is being inserted, so hold `SCN_CHARADDED`
+	bool deferNotifications = false; // hold notifications until a batch of messages ends
+	// Held notifications, along with copies of any text they point to.
+	std::vector<std::pair<NotificationData, std::string>> deferredNotifications;
+#if SCINTERM_STATS
+	RenderCounters counters; // counts for the frame in progress
+	ScintermStats frameStats = {}, totalStats = {}; // counts for the last frame and all frames
+#endif
 
 public:
-	ScintillaCurses(void (*callback_)(void *, int, SCNotification *, void *), void *userdata_);
+	ScintillaCurses(void (*callback_)(void *, int, SCNotification *, void *), void *userdata_,
+		bool headless_ = false);
 	virtual ~ScintillaCurses() override;
 
 private:
@@ -139,6 +960,7 @@ private:
 	void SetVerticalScrollPos() override;
 	void SetHorizontalScrollPos() override;
 	bool ModifyScrollBars(Sci::Line nMax, Sci::Line nPage) override;
+	void ScrollText(Sci::Line linesToMove) override;
 
 	void Copy() override;
 	void Paste() override;
@@ -146,6 +968,7 @@ private:
 
 	void NotifyChange() override;
 	void NotifyParent(NotificationData scn) override;
+	void NotifyModified(Document *document, DocModification mh, void *userData) override;
 
 	int KeyDefault(Keys key, KeyMod modifiers) override;
 
@@ -154,6 +977,7 @@ private:
 	bool FineTickerRunning(TickReason reason) override;
 	void FineTickerStart(TickReason reason, int millis, int tolerance) override;
 	void FineTickerCancel(TickReason reason) override;
+	bool SetIdle(bool on) override;
 
 	void SetMouseCapture(bool on) override;
 	bool HaveMouseCapture() override;
@@ -167,32 +991,81 @@ private:
 
 	void AddToPopUp(const char *label, int cmd = 0, bool enabled = true) override;
 
+	bool PaintArea(PRectangle rc);
+	void RedrawCallTip();
+
+	void FlushInput();
+	bool SuspendAutoHide();
+	void FuzzySelect(bool autoHide);
+	bool MoveMouse(int y, int x, KeyMod modifiers);
+	sptr_t HandleMessage(Message iMessage, uptr_t wParam, sptr_t lParam);
+	void SendDeferredNotifications();
+
 public:
+	static std::set<ScintillaCurses *> instances;
+
+	bool Painting(const Document *document) const noexcept;
 	sptr_t WndProc(Message iMessage, uptr_t wParam, sptr_t lParam) override;
+	void SendMessages(const ScintillaMessage *batch, size_t n, sptr_t *results, bool defer);
 
 	// Access methods for C interface.
 
 	WINDOW *GetWINDOW();
+	void SetAnsiOutput(FILE *out, int y, int x);
+	void GetBounds(int &begy, int &begx, int &maxy, int &maxx);
+	void Resize(int height_, int width_);
+	void Touch();
 
-	void UpdateCursor();
+	void UpdateCursor(bool refresh = true);
 
 	void NoutRefresh();
 	void Refresh();
 
+	void SetFrameRate(int fps);
+	int NextTimeout();
+	void ProcessTimers();
+
 	void KeyPress(int key, KeyMod modifiers);
+	void SendText(std::string_view text, bool paste);
+	void SetFuzzyAutoComplete(bool fuzzy);
+	void ShowVirtualAutoComplete(int lenEntered, int count,
+		const char *(*fetch)(int n, int *type, void *userdata), void *userdata);
 
 	bool MousePress(int y, int x, int button, KeyMod modifiers);
 	bool MouseMove(int y, int x, KeyMod modifiers);
 	void MouseRelease(int y, int x, KeyMod modifiers);
 
 	char *GetClipboard(int *len);
+	const char *BorrowClipboard(size_t *len);
+
+	bool GetStats(ScintermStats *frame, ScintermStats *total);
+
+	const char *GetCell(int y, int x, int *fore, int *back, attr_t *attrs);
 };
 
+std::set<ScintillaCurses *> ScintillaCurses::instances;
+
+namespace {
+
+// Returns whether or not a window is painting the given document. Each window only counts as
+// painting while it paints itself, not while its notifications run (see `NotifyParent()`).
+bool painting_document(const Document *document) {
+	for (ScintillaCurses *sci : ScintillaCurses::instances)
+		if (sci->Painting(document)) return true;
+	return false;
+}
+
+} // namespace
+
 // Creates a new Scintilla instance on a curses `WINDOW`, but does not create that `WINDOW`
 // until absolutely necessary. When it is created, it will initially be full-screen.
+// Headless instances never create a `WINDOW`, and are sized by `Resize()` instead.
 ScintillaCurses::ScintillaCurses(
-	void (*callback_)(void *, int, SCNotification *, void *), void *userdata_)
-		: sur(Surface::Allocate(Technology::Default)), callback(callback_), userdata(userdata_) {
+	void (*callback_)(void *, int, SCNotification *, void *), void *userdata_, bool headless_)
+		: sur(Surface::Allocate(Technology::Default)), headless(headless_), callback(callback_),
+			userdata(userdata_) {
+	instances.insert(this);
+	trace_from_environment();
 
 	// Defaults for curses.
 	marginView.wrapMarkerPaddingRight = 0; // no padding for margin wrap markers
@@ -251,7 +1124,11 @@ ScintillaCurses::ScintillaCurses(
 }
 
 ScintillaCurses::~ScintillaCurses() {
-	if (wMain.GetID()) delwin(GetWINDOW());
+	instances.erase(this);
+	if (!wMain.GetID()) return;
+	register_damage_tracker(wMain.GetID(), nullptr);
+	register_cell_grid(wMain.GetID(), nullptr);
+	if (!headless) delwin(GetWINDOW());
 }
 
 void ScintillaCurses::Initialise() {}
@@ -264,39 +1141,41 @@ void ScintillaCurses::StartDrag() {
 
 void ScintillaCurses::SetVerticalScrollPos() {
 	if (!wMain.GetID() || !verticalScrollBarVisible) return;
-	WINDOW *w = GetWINDOW();
-	int maxy = getmaxy(w), maxx = getmaxx(w);
-	// Draw the gutter.
-	wattr_set(w, 0, term_color_pair(COLOR_WHITE, COLOR_BLACK), nullptr);
-	for (int i = 0; i < maxy; i++) mvwaddch(w, i, maxx - 1, ACS_CKBOARD);
-	// Draw the bar.
+	GetWINDOW(); // ensure the window has been created
+	int maxy = height, maxx = width;
 	scrollBarVPos =
 		static_cast<int>(static_cast<float>(topLine) / (MaxScrollPos() + LinesOnScreen() - 1) * maxy);
-	wattr_set(w, 0, term_color_pair(COLOR_BLACK, COLOR_WHITE), nullptr);
+	const std::array<int, 4> bar{scrollBarVPos, scrollBarHeight, maxy, maxx};
+	if (drawnVScrollBar == bar) return;
+	drawnVScrollBar = bar;
+	// Draw the gutter.
+	for (int i = 0; i < maxy; i++) grid.Put(i, maxx - 1, ACS_CKBOARD, scrollBarFore, scrollBarBack);
+	// Draw the bar.
 	for (int i = scrollBarVPos; i < scrollBarVPos + scrollBarHeight; i++)
-		mvwaddch(w, i, maxx - 1, ' ');
+		grid.Put(i, maxx - 1, ' ', scrollBarBack, scrollBarFore);
 }
 
 void ScintillaCurses::SetHorizontalScrollPos() {
 	if (!wMain.GetID() || !horizontalScrollBarVisible) return;
-	WINDOW *w = GetWINDOW();
-	int maxy = getmaxy(w), maxx = getmaxx(w);
+	GetWINDOW(); // ensure the window has been created
+	int maxy = height, maxx = width;
+	scrollBarHPos = static_cast<int>(static_cast<float>(xOffset) / scrollWidth * maxx);
+	const std::array<int, 4> bar{scrollBarHPos, scrollBarWidth, maxy, maxx};
+	if (drawnHScrollBar == bar) return;
+	drawnHScrollBar = bar;
 	// Draw the gutter.
-	wattr_set(w, 0, term_color_pair(COLOR_WHITE, COLOR_BLACK), nullptr);
-	for (int i = 0; i < maxx; i++) mvwaddch(w, maxy - 1, i, ACS_CKBOARD);
+	grid.Fill(maxy - 1, 0, maxx, ACS_CKBOARD, scrollBarFore, scrollBarBack);
 	// Draw the bar.
-	scrollBarHPos = static_cast<int>(static_cast<float>(xOffset) / scrollWidth * maxx);
-	wattr_set(w, 0, term_color_pair(COLOR_BLACK, COLOR_WHITE), nullptr);
-	for (int i = scrollBarHPos; i < scrollBarHPos + scrollBarWidth; i++)
-		mvwaddch(w, maxy - 1, i, ' ');
+	grid.Fill(maxy - 1, scrollBarHPos, scrollBarHPos + scrollBarWidth, ' ', scrollBarBack,
+		scrollBarFore);
 }
 
 // The height is based on the given size of a page and the total number of pages. The width is
 // based on the width of the view and the view's scroll width property.
 bool ScintillaCurses::ModifyScrollBars(Sci::Line nMax, Sci::Line nPage) {
 	if (!wMain.GetID()) return false;
-	WINDOW *w = GetWINDOW();
-	int maxy = getmaxy(w), maxx = getmaxx(w);
+	GetWINDOW(); // ensure the window has been created
+	int maxy = height, maxx = width;
 	int bar_height = static_cast<int>(roundf(static_cast<float>(nPage) / nMax * maxy));
 	scrollBarHeight = std::clamp(bar_height, 1, maxy);
 	int bar_width = static_cast<int>(roundf(static_cast<float>(maxx) / scrollWidth * maxx));
@@ -304,17 +1183,44 @@ bool ScintillaCurses::ModifyScrollBars(Sci::Line nMax, Sci::Line nPage) {
 	return true;
 }
 
+// Scrolls the text area's cells along with the lines they show instead of repainting all of
+// them, so only the lines scrolled into view are repainted. Curses scrolls the terminal with
+// a scroll region (`wscrl()`), as do ANSI screens when they can.
+// Scintilla only scrolls by a few lines at a time this way, and redraws everything otherwise.
+void ScintillaCurses::ScrollText(Sci::Line linesToMove) {
+	WINDOW *w = wMain.GetID() ? GetWINDOW() : nullptr;
+	int n = static_cast<int>(linesToMove) * vs.lineHeight;
+	int bottom = height - (horizontalScrollBarVisible ? 1 : 0);
+	if (!wMain.GetID() || std::abs(n) >= bottom || grid.Height() != height ||
+		(w && (getmaxy(w) != height || getmaxx(w) != width))) {
+		Redraw();
+		return;
+	}
+	TraceSpan span("ScrollText", "lines", n);
+	if (w) {
+		wsetscrreg(w, 0, bottom - 1), scrollok(w, TRUE), wscrl(w, -n), scrollok(w, FALSE);
+		wsetscrreg(w, 0, height - 1);
+	} else if (ansi)
+		ansi->Scroll(0, bottom, n);
+	grid.Scroll(0, bottom, n), damage.Scroll(0, bottom, n);
+	drawnVScrollBar.reset(); // scrolled along with the text
+}
+
 // Internal copy; primary and secondary X selections are unaffected.
 void ScintillaCurses::Copy() {
-	if (!sel.Empty()) CopySelectionRange(&clipboard);
+	if (sel.Empty()) return;
+	auto text = std::make_shared<SelectionText>();
+	CopySelectionRange(text.get());
+	clipboard = std::move(text);
 }
 
 // Pastes from internal clipboard, not from primary or secondary X selections.
 void ScintillaCurses::Paste() {
-	if (clipboard.Empty()) return;
+	const auto text = clipboard; // a copy or cut while pasting must not free the text
+	if (text->Empty()) return;
 	ClearSelection(multiPasteMode == MultiPaste::Each);
-	InsertPasteShape(clipboard.Data(), static_cast<int>(clipboard.Length()),
-		!clipboard.rectangular ? PasteShape::stream : PasteShape::rectangular);
+	InsertPasteShape(text->Data(), static_cast<int>(text->Length()),
+		!text->rectangular ? PasteShape::stream : PasteShape::rectangular);
 	EnsureCaretVisible();
 }
 
@@ -323,9 +1229,41 @@ void ScintillaCurses::ClaimSelection() {}
 void ScintillaCurses::NotifyChange() {}
 
 void ScintillaCurses::NotifyParent(NotificationData scn) {
+	if (typingRun && scn.nmhdr.code == Notification::CharAdded) return; // see `SendText()`
+	if (deferNotifications) {
+		// Successive UI updates collapse into one. Notification text only lives as long as the
+		// notification, so keep a copy of it.
+		auto &held = deferredNotifications;
+		if (scn.nmhdr.code == Notification::UpdateUI && !held.empty() &&
+			held.back().first.nmhdr.code == Notification::UpdateUI)
+			held.back().first.updated = held.back().first.updated | scn.updated;
+		else if (!scn.text)
+			held.emplace_back(scn, std::string{});
+		else
+			held.emplace_back(scn, scn.length > 0 ?
+					std::string(scn.text, static_cast<size_t>(scn.length)) :
+					std::string(scn.text));
+		return;
+	}
+	count_stat(notifications, 1);
+	// The application may ask for styled text, which it needs right away, even while painting.
+	bool wasPainting = std::exchange(painting, false);
 	if (callback)
 		(*callback)(
 			reinterpret_cast<void *>(this), 0, reinterpret_cast<SCNotification *>(&scn), userdata);
+	painting = wasPainting;
+}
+
+// Text changes make any background lexing of the document stale. They also change the word
+// being completed, which Scintilla looks up in the whole autocompletion list, not just the
+// items shown by `FuzzySelect()`.
+void ScintillaCurses::NotifyModified(Document *document, DocModification mh, void *userData) {
+	if (FlagSet(mh.modificationType, ModificationFlags::InsertText) ||
+		FlagSet(mh.modificationType, ModificationFlags::DeleteText)) {
+		cancel_background_lexing(document);
+		if (ac.Active()) static_cast<ListBoxImpl *>(ac.lb.get())->Filter({});
+	}
+	ScintillaBase::NotifyModified(document, mh, userData);
 }
 
 int ScintillaCurses::KeyDefault(Keys key, KeyMod modifiers) {
@@ -350,14 +1288,34 @@ int ScintillaCurses::KeyDefault(Keys key, KeyMod modifiers) {
 
 // Internal copy; primary and secondary X selections are unaffected.
 void ScintillaCurses::CopyToClipboard(const SelectionText &selectedText) {
-	clipboard.Copy(selectedText);
+	auto text = std::make_shared<SelectionText>();
+	text->Copy(selectedText);
+	clipboard = std::move(text);
 }
 
-bool ScintillaCurses::FineTickerRunning(TickReason /*reason*/) { return false; }
+bool ScintillaCurses::FineTickerRunning(TickReason reason) {
+	return tickers[static_cast<size_t>(reason)].interval.count() > 0;
+}
 
-void ScintillaCurses::FineTickerStart(TickReason /*reason*/, int /*millis*/, int /*tolerance*/) {}
+// Timers only run when the application calls `ProcessTimers()`, so *tolerance* is moot.
+// Terminals blink their own cursors, so there is no need to blink curses carets.
+void ScintillaCurses::FineTickerStart(TickReason reason, int millis, int /*tolerance*/) {
+	FineTickerCancel(reason);
+	if (millis <= 0 || (reason == TickReason::caret && FlagSet(vs.caret.style, CaretStyle::Curses)))
+		return;
+	auto interval = std::chrono::milliseconds(millis);
+	tickers[static_cast<size_t>(reason)] = {std::chrono::steady_clock::now() + interval, interval};
+}
 
-void ScintillaCurses::FineTickerCancel(TickReason /*reason*/) {}
+void ScintillaCurses::FineTickerCancel(TickReason reason) {
+	tickers[static_cast<size_t>(reason)].interval = std::chrono::milliseconds(0);
+}
+
+// Idle work (e.g. `SC_IDLESTYLING` and wrapping) is done in `ProcessTimers()`.
+bool ScintillaCurses::SetIdle(bool on) {
+	idler.state = on;
+	return true;
+}
 
 void ScintillaCurses::SetMouseCapture(bool on) { capturedMouse = on; }
 
@@ -376,8 +1334,9 @@ sptr_t ScintillaCurses::DefWndProc(Message /*iMessage*/, uptr_t /*wParam*/, sptr
 	return 0;
 }
 
+// Headless windows have no screen to show call tips on.
 void ScintillaCurses::CreateCallTipWindow(PRectangle rc) {
-	if (!wMain.GetID()) return;
+	if (!wMain.GetID() || headless) return;
 	if (!ct.wCallTip.Created()) {
 		rc.right -= 1; // remove right-side padding
 		int begx = 0, begy = 0, maxx = 0, maxy = 0;
@@ -390,66 +1349,188 @@ void ScintillaCurses::CreateCallTipWindow(PRectangle rc) {
 		if (rc.Height() > maxy) rc.bottom = rc.top + maxy;
 		ct.wCallTip = newwin(static_cast<int>(rc.Height()), static_cast<int>(rc.Width()),
 			static_cast<int>(rc.top), static_cast<int>(rc.left));
-	}
+		WINDOW *w = _WINDOW(ct.wCallTip.GetID());
+		callTipDamage.Resize(getmaxy(w), getmaxx(w));
+		register_damage_tracker(ct.wCallTip.GetID(), &callTipDamage); // see `Window::Destroy()`
+	} else
+		callTipDamage.AddAll(); // a new call tip in the same window
+	RedrawCallTip();
+}
+
+// Repaints the call tip only if Scintilla invalidated it (e.g. to highlight a different
+// argument), and otherwise shows what its window already has over the Scintilla window.
+void ScintillaCurses::RedrawCallTip() {
 	WindowID wid = ct.wCallTip.GetID();
-	std::unique_ptr<Surface> surface = Surface::Allocate(Technology::Default);
-	if (surface) {
-		surface->Init(wid);
-		dynamic_cast<SurfaceImpl *>(surface.get())->isCallTip = true;
-		ct.PaintCT(surface.get());
-		wattr_set(_WINDOW(wid), 0, term_color_pair(COLOR_WHITE, COLOR_BLACK), nullptr);
-		box(_WINDOW(wid), '|', '-');
-		wnoutrefresh(_WINDOW(wid));
+	WINDOW *w = _WINDOW(wid);
+	if (!callTipDamage.Empty()) {
+		TraceSpan span("CallTipPaint");
+		if (!callTipSur) callTipSur = Surface::Allocate(Technology::Default);
+		callTipDamage.Take();
+		callTipGrid.Resize(getmaxy(w), getmaxx(w));
+		register_cell_grid(wid, &callTipGrid);
+		callTipSur->Init(wid);
+		ct.PaintCT(callTipSur.get());
+		callTipSur->Release();
+		register_cell_grid(wid, nullptr);
+		callTipGrid.Flush(w);
+		callTipGrid.Box(w, term_color_pair(COLOR_WHITE, COLOR_BLACK));
 	}
+	touchwin(w), wnoutrefresh(w);
 }
 
 void ScintillaCurses::AddToPopUp(const char * /*label*/, int /*cmd*/, bool /*enabled*/) {}
 
 sptr_t ScintillaCurses::WndProc(Message iMessage, uptr_t wParam, sptr_t lParam) {
+	STATS_SCOPE;
+	TraceSpan span("WndProc", "message", static_cast<long>(iMessage));
+	FlushInput();
 	try {
-		switch (iMessage) {
-		case Message::GetDirectFunction: return reinterpret_cast<sptr_t>(scintilla_send_message);
-		case Message::GetDirectPointer: return reinterpret_cast<sptr_t>(this);
-		// Ignore attempted changes of the following unsupported properties.
-		case Message::SetBufferedDraw:
-		case Message::SetWhitespaceSize:
-		case Message::SetPhasesDraw:
-		case Message::SetExtraAscent:
-		case Message::SetExtraDescent: return 0;
-		// Intercept StyleSetUnderline to utilize StyleSetStretch.
-		// Scintilla does not store the underline property in the FontParameters struct because
-		// it draws underlines independently of drawing text. However, curses draws underlines
-		// while drawing text, so the font needs to contain underlining information. The only
-		// font properties accessible are weight and stretch. Since weight is tied to bold,
-		// utilize stretch, which also happens to be meaningless in curses.
-		case Message::StyleSetUnderline:
-			ScintillaBase::WndProc(Message::StyleSetStretch, wParam,
-				lParam ? A_UNDERLINE : static_cast<int>(FontStretch::Normal));
-			[[fallthrough]];
-		// Pass to Scintilla.
-		default: return ScintillaBase::WndProc(iMessage, wParam, lParam);
-		}
+		return HandleMessage(iMessage, wParam, lParam);
 	} catch (std::bad_alloc &) { errorStatus = Status::BadAlloc; } catch (...) {
 		errorStatus = Status::Failure;
 	}
 	return 0;
 }
 
+// Sends each message in a batch to Scintilla, storing their results if requested.
+// Unlike `WndProc()`, there is only one exception handler for the entire batch. The first
+// message that fails stops the batch, and the rest are not sent (their results are `0`). If
+// *defer* is `true`, notifications are held until the batch ends.
+void ScintillaCurses::SendMessages(
+	const ScintillaMessage *batch, size_t n, sptr_t *results, bool defer) {
+	STATS_SCOPE;
+	TraceSpan span("SendMessages", "messages", static_cast<long>(n));
+	FlushInput();
+	if (results) std::fill_n(results, n, 0);
+	const bool wasDeferring = std::exchange(deferNotifications, deferNotifications || defer);
+	try {
+		for (size_t i = 0; i < n; i++) {
+			const sptr_t result = HandleMessage(
+				static_cast<Message>(batch[i].message), batch[i].wParam, batch[i].lParam);
+			if (results) results[i] = result;
+		}
+	} catch (std::bad_alloc &) { errorStatus = Status::BadAlloc; } catch (...) {
+		errorStatus = Status::Failure;
+	}
+	deferNotifications = wasDeferring;
+	if (!deferNotifications) SendDeferredNotifications();
+}
+
+// Sends notifications held during a batch of messages to the application.
+// A notification handler may send another batch, so take the held notifications first.
+void ScintillaCurses::SendDeferredNotifications() {
+	auto held = std::exchange(deferredNotifications, {});
+	for (auto &[scn, text] : held) {
+		if (scn.text) scn.text = text.c_str();
+		NotifyParent(scn);
+	}
+}
+
+// Handles a message for `WndProc()` or `SendMessages()`, which catch any exceptions thrown.
+sptr_t ScintillaCurses::HandleMessage(Message iMessage, uptr_t wParam, sptr_t lParam) {
+	switch (iMessage) {
+	case Message::GetDirectFunction: return reinterpret_cast<sptr_t>(scintilla_send_message);
+	case Message::GetDirectPointer: return reinterpret_cast<sptr_t>(this);
+	// Ignore attempted changes of the following unsupported properties.
+	case Message::SetBufferedDraw:
+	case Message::SetWhitespaceSize:
+	case Message::SetPhasesDraw:
+	case Message::SetExtraAscent:
+	case Message::SetExtraDescent: return 0;
+	// Lists shown with messages are not virtual.
+	case Message::AutoCShow:
+	case Message::UserListShow: {
+		static_cast<ListBoxImpl *>(ac.lb.get())->SetSource(0, nullptr, nullptr);
+		bool autoHide = SuspendAutoHide();
+		sptr_t result = ScintillaBase::WndProc(iMessage, wParam, lParam);
+		FuzzySelect(autoHide);
+		return result;
+	}
+	// Scintilla selects items by searching the whole list.
+	case Message::AutoCSelect:
+		if (ac.Active()) static_cast<ListBoxImpl *>(ac.lb.get())->Filter({});
+		return ScintillaBase::WndProc(iMessage, wParam, lParam);
+	// Intercept StyleSetUnderline to utilize StyleSetStretch.
+	// Scintilla does not store the underline property in the FontParameters struct because
+	// it draws underlines independently of drawing text. However, curses draws underlines
+	// while drawing text, so the font needs to contain underlining information. The only
+	// font properties accessible are weight and stretch. Since weight is tied to bold,
+	// utilize stretch, which also happens to be meaningless in curses.
+	case Message::StyleSetUnderline:
+		ScintillaBase::WndProc(Message::StyleSetStretch, wParam,
+			lParam ? A_UNDERLINE : static_cast<int>(FontStretch::Normal));
+		[[fallthrough]];
+	// Pass to Scintilla.
+	default: return ScintillaBase::WndProc(iMessage, wParam, lParam);
+	}
+}
+
+// Headless windows are created just the same, but have no curses `WINDOW` to return.
 WINDOW *ScintillaCurses::GetWINDOW() {
 	if (!wMain.GetID()) {
-		init_colors();
-		wMain = newwin(0, 0, 0, 0);
-		WINDOW *w = _WINDOW(wMain.GetID());
-		keypad(w, TRUE);
+		if (!headless) {
+			init_colors();
+			wMain = newwin(0, 0, 0, 0);
+			keypad(_WINDOW(wMain.GetID()), TRUE);
+			idlok(_WINDOW(wMain.GetID()), TRUE); // allow scrolling with `ScrollText()`
+			getmaxyx(_WINDOW(wMain.GetID()), height, width);
+		} else
+			wMain = &grid; // see `headless_grid()`
+		WindowID w = wMain.GetID();
+		grid.Resize(height, width), damage.Resize(height, width);
+		register_cell_grid(w, &grid), register_damage_tracker(w, &damage);
 		if (sur) sur->Init(w);
-		getmaxyx(w, height, width);
 		InvalidateStyleRedraw(); // needed to fully initialize Scintilla
 	}
-	return _WINDOW(wMain.GetID());
+	return !headless ? _WINDOW(wMain.GetID()) : nullptr;
+}
+
+// Has a headless window write its cells to the given terminal at the given position with ANSI
+// escape sequences whenever it is refreshed.
+// 24-bit colors are written if the `COLORTERM` environment variable says the terminal supports
+// them, and xterm's 256 colors are written otherwise.
+void ScintillaCurses::SetAnsiOutput(FILE *out, int y, int x) {
+	const char *colorterm = getenv("COLORTERM");
+	bool trueColor =
+		colorterm && (strcmp(colorterm, "truecolor") == 0 || strcmp(colorterm, "24bit") == 0);
+	ansi = std::make_unique<AnsiScreen>(out, y, x, trueColor);
+}
+
+// Gets the screen position and size of the window. Headless windows are at (0, 0) unless they
+// write to a terminal.
+void ScintillaCurses::GetBounds(int &begy, int &begx, int &maxy, int &maxx) {
+	WINDOW *w = GetWINDOW();
+	begy = w ? getbegy(w) : ansi ? ansi->Top() : 0, begx = w ? getbegx(w) : ansi ? ansi->Left() : 0;
+	maxy = w ? getmaxy(w) : height, maxx = w ? getmaxx(w) : width;
+}
+
+// Resizes the window. Scintilla adapts to the new size on the next refresh, which repaints all
+// of the window.
+void ScintillaCurses::Resize(int height_, int width_) {
+	if (!headless) {
+		wresize(GetWINDOW(), height_, width_);
+		Touch();
+		return;
+	}
+	height = std::max(height_, 1), width = std::max(width_, 1);
+	if (ansi) ansi->Invalidate();
+	if (!wMain.GetID()) return; // sized when created
+	grid.Resize(height, width), damage.Resize(height, width), ChangeSize();
+}
+
+// Repaints all of the window on the next refresh and writes all of it to the virtual screen (or
+// terminal), since refreshes normally only write what changed. This is for when the application
+// drew over the window.
+void ScintillaCurses::Touch() {
+	damage.AddAll();
+	if (WINDOW *w = wMain.GetID() ? GetWINDOW() : nullptr) touchwin(w);
+	if (ansi) ansi->Invalidate();
 }
 
 // Update even if it's not visible, as the container may have a use for it.
-void ScintillaCurses::UpdateCursor() {
+// Unless *refresh* is `false`, the cursor moves on the terminal right away instead of with the
+// next `doupdate()` (or `AnsiScreen::Write()`).
+void ScintillaCurses::UpdateCursor(bool refresh) {
 	sptr_t pos = WndProc(Message::GetCurrentPos, 0, 0);
 	if (!SelectionEmpty() && !FlagSet(vs.caret.style, CaretStyle::BlockAfter) &&
 		(pos > WndProc(Message::GetAnchor, 0, 0)))
@@ -458,35 +1539,110 @@ void ScintillaCurses::UpdateCursor() {
 	auto y = static_cast<int>(point.y), x = static_cast<int>(point.x);
 	if (UserVirtualSpace()) x += static_cast<int>(sel.RangeMain().caret.VirtualSpace());
 	WINDOW *win = GetWINDOW();
+	if (!win) {
+		if (!ansi) return; // headless
+		bool in_view = x >= 0 && x < width && y >= 0 && y < height;
+		if (in_view) ansi->MoveCursor(y, x);
+		if (hasFocus && FlagSet(vs.caret.style, CaretStyle::Curses)) ansi->ShowCursor(in_view);
+		if (refresh) ansi->Write();
+		return;
+	}
 	bool in_view = x >= 0 && x <= getmaxx(win) && y >= 0 && y <= getmaxy(win);
-	if (in_view) wmove(win, y, x), wrefresh(win);
+	if (in_view) wmove(win, y, x), refresh ? wrefresh(win) : wnoutrefresh(win);
+	// Note: curses only writes cursor visibility changes, but writes them immediately.
 	if (hasFocus && FlagSet(vs.caret.style, CaretStyle::Curses)) curs_set(in_view ? 1 : 0);
 }
 
-// Repaints the Scintilla window on the virtual screen.
+// Returns whether or not this window is painting the given document, so styling it can be done
+// in the background.
+bool ScintillaCurses::Painting(const Document *document) const noexcept {
+	return painting && pdoc == document;
+}
+
+// Paints the given area of the Scintilla window.
+// Returns whether or not painting completed. If it was abandoned, the area was insufficient
+// to cover new styling or brace highlight positions, and the whole window needs painting.
+bool ScintillaCurses::PaintArea(PRectangle rc) {
+	TraceSpan span("Paint", "rows", static_cast<long>(rc.Height()));
+	count_stat(rowsPainted, static_cast<unsigned long>(rc.Height()));
+	rcPaint = rc;
+	paintState = PaintState::painting;
+	paintingAllText = rcPaint.Contains(GetClientRectangle());
+	bool wasPainting = std::exchange(painting, true);
+	Paint(sur.get(), rcPaint);
+	painting = wasPainting;
+	bool abandoned = paintState == PaintState::abandoned;
+	paintState = PaintState::notPainting;
+	return !abandoned;
+}
+
+// Repaints the damaged areas of the Scintilla window on the virtual screen. If nothing was
+// invalidated since the last refresh, nothing is repainted.
 // If an autocompletion list, user list, or calltip is active, redraw it over the buffer's
 // contents.
 // It is the application's responsibility to call the curses `doupdate()` in order to refresh
 // the physical screen. To paint to the physical screen instead, use `Refresh()`.
+// If refreshes are limited and the next frame is not due yet, nothing is repainted until a
+// refresh after it is due.
 void ScintillaCurses::NoutRefresh() {
+	if (frameInterval.count() > 0) {
+		auto now = std::chrono::steady_clock::now();
+		if (now - lastFrame < frameInterval) {
+			framePending = true;
+			return;
+		}
+		lastFrame = now, framePending = false;
+	}
+	FRAME_SCOPE;
+	TraceSpan span("NoutRefresh");
+	FlushInput();
 	WINDOW *w = GetWINDOW();
-	rcPaint.top = 0, rcPaint.left = 0; // paint from (0, 0), not (begy, begx)
-	getmaxyx(w, rcPaint.bottom, rcPaint.right);
-	if (rcPaint.bottom != height || rcPaint.right != width)
-		height = static_cast<int>(rcPaint.bottom), width = static_cast<int>(rcPaint.right),
+	int maxy = height, maxx = width;
+	if (w) getmaxyx(w, maxy, maxx);
+	if (maxy != height || maxx != width)
+		height = maxy, width = maxx, grid.Resize(height, width), damage.Resize(height, width),
 		ChangeSize();
-	Paint(sur.get(), rcPaint);
-	SetVerticalScrollPos(), SetHorizontalScrollPos();
-	wnoutrefresh(w);
-	if (ac.Active())
+	for (PRectangle rc : damage.Take()) {
+		bool painted = PaintArea(rc);
+		if (!painted)
+			rc = PRectangle(0, 0, width, height), PaintArea(rc); // paint from (0, 0), not (begy, begx)
+		// Text is painted under the scroll bars, so redraw any it covered.
+		if (rc.right >= width) drawnVScrollBar.reset();
+		if (rc.bottom >= height) drawnHScrollBar.reset();
+		if (!painted) break;
+	}
+	{
+		TraceSpan scrollBarsSpan("ScrollBars");
+		SetVerticalScrollPos(), SetHorizontalScrollPos();
+	}
+	if (!w) {
+		if (!ansi) return; // headless windows are only painted into their cell grid
+		TraceSpan ansiSpan("AnsiFlush");
+		ansi->Flush(grid);
+		if (hasFocus) UpdateCursor(false);
+		ansi->Write();
+		return;
+	}
+	{
+		TraceSpan flushSpan("Flush");
+		grid.Flush(w);
+		// Restore any parts of the window that a previous autocompletion list or call tip covered.
+		if (popupShown) touchwin(w);
+		wnoutrefresh(w);
+	}
+	popupShown = ac.Active() || ct.inCallTipMode;
+	if (ac.Active()) {
+		TraceSpan popupSpan("AutoCompleteRedraw");
 		ac.lb->Select(ac.lb->GetSelection()); // redraw
-	else if (ct.inCallTipMode)
-		CreateCallTipWindow(PRectangle(0, 0, 0, 0)); // redraw
+	} else if (ct.inCallTipMode && ct.wCallTip.Created()) {
+		TraceSpan popupSpan("CallTipRedraw");
+		RedrawCallTip();
+	}
 #if PDCURSES
 	else
 		touchwin(w); // pdcurses has problems after drawing overlapping windows
 #endif
-	if (hasFocus) UpdateCursor();
+	if (hasFocus) UpdateCursor(false); // the cursor moves along with the next `doupdate()`
 }
 
 // Repaints the Scintilla window on the physical screen.
@@ -495,25 +1651,200 @@ void ScintillaCurses::NoutRefresh() {
 // To paint to the virtual screen instead, use `NoutRefresh()`.
 void ScintillaCurses::Refresh() {
 	NoutRefresh();
+	if (headless || framePending) return;
+	TraceSpan span("doupdate");
 	doupdate();
 }
 
+// Limits refreshes to the given number of frames per second, or removes the limit if *fps* is
+// `0`. Refreshes that come too soon after the last frame are put off until the next frame is
+// due, and mouse wheel scrolling and mouse moves are coalesced until then.
+void ScintillaCurses::SetFrameRate(int fps) {
+	FlushInput();
+	frameInterval = std::chrono::steady_clock::duration::zero();
+	if (fps > 0) frameInterval = std::chrono::steady_clock::duration(std::chrono::seconds(1)) / fps;
+}
+
+// Returns the number of milliseconds until the next timer or put off frame is due, `0` if there
+// is idle work to do or background lexing to publish, or `-1` if there is nothing to wait for.
+int ScintillaCurses::NextTimeout() {
+	int lexing = background_lexing_timeout();
+	if (idler.state || lexing == 0) return 0;
+	std::optional<std::chrono::steady_clock::time_point> due;
+	if (framePending) due = lastFrame + frameInterval;
+	for (const Ticker &ticker : tickers)
+		if (ticker.interval.count() > 0 && (!due || ticker.due < *due)) due = ticker.due;
+	if (!due) return lexing;
+	auto wait = std::chrono::ceil<std::chrono::milliseconds>(*due - std::chrono::steady_clock::now());
+	int timeout = static_cast<int>(std::clamp<long long>(wait.count(), 0, INT_MAX));
+	return lexing > 0 ? std::min(timeout, lexing) : timeout;
+}
+
+// Publishes any styles lexed in the background, runs the timers that are due, and then does
+// a slice of any idle work.
+// Timers that fell more than an interval behind (e.g. the application was busy) only run once.
+void ScintillaCurses::ProcessTimers() {
+	STATS_SCOPE;
+	TraceSpan span("ProcessTimers");
+	FlushInput(); // timers like autoscrolling use the latest mouse position
+	{
+		TraceSpan publishSpan("PublishLexing");
+		publish_background_lexing();
+	}
+	auto now = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < tickers.size(); i++) {
+		Ticker &ticker = tickers[i];
+		if (ticker.interval.count() == 0 || ticker.due > now) continue;
+		ticker.due += ticker.interval;
+		if (ticker.due <= now) ticker.due = now + ticker.interval;
+		TickFor(static_cast<TickReason>(i));
+	}
+	if (idler.state && !Idle()) SetIdle(false);
+}
+
+// Handles any mouse wheel scrolling and mouse move that were coalesced while refreshes are
+// limited, so that input is handled in order and frames show all of it.
+void ScintillaCurses::FlushInput() {
+	if (wheelLines == 0 && wheelColumns == 0 && !pendingMove) return;
+	TraceSpan span("FlushInput");
+	if (int lines = std::exchange(wheelLines, 0); lines != 0) ScrollTo(topLine + lines);
+	if (int columns = std::exchange(wheelColumns, 0); columns != 0)
+		HorizontalScrollTo(xOffset + columns);
+	if (auto move = std::exchange(pendingMove, std::nullopt)) {
+		auto [y, x, modifiers] = *move;
+		MoveMouse(y, x, modifiers);
+	}
+}
+
 // Sends a key to Scintilla.
 // Usually if a key is consumed, the screen should be repainted. However, when autocomplete is
 // active, that window is consuming the keys and any repainting of the main Scintilla window
 // will overwrite the autocomplete window.
 void ScintillaCurses::KeyPress(int key, KeyMod modifiers) {
+	STATS_SCOPE;
+	TraceSpan span("KeyPress", "key", key);
+	FlushInput();
+	bool autoHide = SuspendAutoHide();
 	KeyDownWithModifiers(static_cast<Keys>(key), modifiers, nullptr);
+	FuzzySelect(autoHide);
+}
+
+// Sends text to Scintilla all at once, as a single undo action.
+// Pasted text replaces the selection (or each selection, depending on `SCI_SETMULTIPASTE`) with
+// a single insertion, like `Paste()` does with the clipboard. Otherwise the text is typed as if
+// each of its characters had been sent by `KeyPress()`, which honors overtype, multiple
+// selections, and autocompletion. Runs of characters typed while neither autocompletion nor
+// overtype is active are inserted at once, with `SCN_CHARADDED` only for their last character.
+// Typed line endings ("\r\n", '\r', or '\n') are new lines, as if Enter had been pressed.
+void ScintillaCurses::SendText(std::string_view text, bool paste) {
+	STATS_SCOPE;
+	TraceSpan span("SendText", "bytes", static_cast<long>(text.length()));
+	FlushInput();
+	UndoGroup ug(pdoc);
+	bool autoHide = SuspendAutoHide();
+	if (paste) {
+		ClearSelection(multiPasteMode == MultiPaste::Each);
+		InsertPasteShape(text.data(), static_cast<Sci::Position>(text.length()), PasteShape::stream);
+		EnsureCaretVisible();
+		FuzzySelect(autoHide);
+		return;
+	}
+	auto plain = [&text](size_t i) { return static_cast<unsigned char>(text[i]) >= ' '; };
+	auto length = [this, &text](size_t i) -> size_t {
+		return IsUnicodeMode() ? UTF8DrawBytes(text.data() + i, text.length() - i) : 1;
+	};
+	for (size_t i = 0; i < text.length();) {
+		if (text[i] == '\r' || text[i] == '\n') {
+			KeyCommand(Message::NewLine); // completes any autocompletion, like Enter
+			i += text.substr(i, 2) == "\r\n" ? 2 : 1;
+			continue;
+		} else if (auto ch = static_cast<unsigned char>(text[i]); ch < ' ') {
+			KeyDownWithModifiers(static_cast<Keys>(ch), KeyMod::Norm, nullptr), i++; // e.g. Tab
+			continue;
+		}
+		size_t len = length(i);
+		if (!ac.Active() && !inOverstrike) {
+			size_t last = i;
+			while (last + len < text.length() && plain(last + len)) last += len, len = length(last);
+			if (last > i) {
+				typingRun = true;
+				InsertCharacter(text.substr(i, last - i), CharacterSource::DirectInput);
+				typingRun = false, i = last;
+			}
+		}
+		InsertCharacter(text.substr(i, len), CharacterSource::DirectInput), i += len;
+	}
+	FuzzySelect(autoHide);
+}
+
+// Sets whether to show the autocompletion or user list items that fuzzy match the word being
+// completed when no item starts with it.
+void ScintillaCurses::SetFuzzyAutoComplete(bool fuzzy) { fuzzyAutoComplete = fuzzy; }
+
+// Shows an autocompletion list whose items are fetched from the given function as they are
+// needed instead of being passed all at once.
+// Scintilla binary searches lists as the user types, so the items must be sorted, regardless of
+// `SCI_AUTOCSETORDER`. A list with a single item is completed right away if
+// `SCI_AUTOCSETCHOOSESINGLE` is enabled, like any other list.
+void ScintillaCurses::ShowVirtualAutoComplete(int lenEntered, int count,
+	const char *(*fetch)(int n, int *type, void *userdata), void *userdata) {
+	STATS_SCOPE;
+	TraceSpan span("ShowVirtualAutoComplete", "items", count);
+	FlushInput();
+	auto listbox = static_cast<ListBoxImpl *>(ac.lb.get());
+	if (count == 1 && ac.chooseSingle) {
+		int type;
+		const char *item = fetch(0, &type, userdata);
+		listbox->SetSource(0, nullptr, nullptr);
+		AutoCompleteStart(lenEntered, item ? item : "");
+		return;
+	}
+	listbox->SetSource(count, fetch, userdata);
+	bool autoHide = SuspendAutoHide();
+	Ordering order = std::exchange(ac.autoSort, Ordering::PreSorted); // do not sort the list text
+	// A separator keeps Scintilla from treating the ignored list text as a single item.
+	AutoCompleteStart(lenEntered, std::string(1, ac.GetSeparator()).c_str());
+	ac.autoSort = order;
+	FuzzySelect(autoHide);
+}
+
+// Keeps Scintilla from hiding lists without an item that starts with the word being completed
+// while fuzzy matching is enabled, so `FuzzySelect()` can match them instead.
+// Returns the auto-hide setting to restore with `FuzzySelect()`.
+bool ScintillaCurses::SuspendAutoHide() {
+	return fuzzyAutoComplete ? std::exchange(ac.autoHide, false) : ac.autoHide;
+}
+
+// Restores the given auto-hide setting and, if fuzzy matching is enabled and Scintilla found no
+// list item that starts with the word being completed, shows only the items that match that
+// word as a subsequence, best match first. If none do, the list is hidden if *autoHide* is
+// enabled, as Scintilla would have done.
+void ScintillaCurses::FuzzySelect(bool autoHide) {
+	ac.autoHide = autoHide;
+	if (!fuzzyAutoComplete || !ac.Active() || ac.lb->GetSelection() != -1) return;
+	TraceSpan span("FuzzySelect");
+	Sci::Position start = ac.posStart - ac.startLen, end = sel.MainCaret();
+	auto listbox = static_cast<ListBoxImpl *>(ac.lb.get());
+	std::vector<int> matches;
+	if (end > start) matches = listbox->FindFuzzy(RangeText(start, end));
+	if (matches.empty()) {
+		if (autoHide) AutoCompleteCancel();
+		return;
+	}
+	listbox->Filter(std::move(matches)), listbox->Select(0);
 }
 
 // Handles a mouse button press, with coordinates relative to this window.
 // Returns whether or not the press was handled.
 bool ScintillaCurses::MousePress(int y, int x, int button, KeyMod modifiers) {
+	STATS_SCOPE;
+	TraceSpan span("MousePress", "button", button);
+	FlushInput();
 	const auto now = std::chrono::system_clock::now().time_since_epoch();
 	auto time =
 		static_cast<unsigned int>(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
 	GetWINDOW(); // ensure the curses `WINDOW` has been created
-	if (ac.Active() && (button == 1 || button == 4 || button == 5)) {
+	if (ac.Active() && ac.lb->GetID() && (button == 1 || button == 4 || button == 5)) {
 		// Select an autocompletion list item if possible or scroll the list.
 		WINDOW *w = _WINDOW(ac.lb->GetID()), *parent = GetWINDOW();
 		int begy = getbegy(w) - getbegy(parent); // y is relative to the view
@@ -552,7 +1883,7 @@ bool ScintillaCurses::MousePress(int y, int x, int button, KeyMod modifiers) {
 			return true;
 		}
 		if (ry == 0 || ry == maxy || rx == 0 || rx == maxx) return true; // ignore border click
-	} else if (ct.inCallTipMode && button == 1) {
+	} else if (ct.inCallTipMode && ct.wCallTip.Created() && button == 1) {
 		// Send the click to the CallTip.
 		WINDOW *w = _WINDOW(ct.wCallTip.GetID()), *parent = GetWINDOW();
 		int begy = getbegy(w) - getbegy(parent); // y is relative to the view
@@ -566,16 +1897,16 @@ bool ScintillaCurses::MousePress(int y, int x, int button, KeyMod modifiers) {
 	}
 
 	if (button == 1) {
-		if (verticalScrollBarVisible && x == getmaxx(GetWINDOW()) - 1) {
+		if (verticalScrollBarVisible && x == width - 1) {
 			// Scroll the vertical scrollbar.
 			if (y < scrollBarVPos) return (ScrollTo(topLine - LinesOnScreen()), true);
 			if (y >= scrollBarVPos + scrollBarHeight) return (ScrollTo(topLine + LinesOnScreen()), true);
 			draggingVScrollBar = true, dragOffset = y - scrollBarVPos;
-		} else if (horizontalScrollBarVisible && y == getmaxy(GetWINDOW()) - 1) {
+		} else if (horizontalScrollBarVisible && y == height - 1) {
 			// Scroll the horizontal scroll bar.
-			if (x < scrollBarHPos) return (HorizontalScrollTo(xOffset - getmaxx(GetWINDOW()) / 2), true);
+			if (x < scrollBarHPos) return (HorizontalScrollTo(xOffset - width / 2), true);
 			if (x >= scrollBarHPos + scrollBarWidth)
-				return (HorizontalScrollTo(xOffset + getmaxx(GetWINDOW()) / 2), true);
+				return (HorizontalScrollTo(xOffset + width / 2), true);
 			draggingHScrollBar = true, dragOffset = x - scrollBarHPos;
 		} else {
 			// Have Scintilla handle the click.
@@ -585,25 +1916,40 @@ bool ScintillaCurses::MousePress(int y, int x, int button, KeyMod modifiers) {
 	} else if (button == 4 || button == 5) {
 		// Scroll the view (horizontally if shift is pressed).
 		bool shift = (modifiers & KeyMod::Shift) == KeyMod::Shift;
-		int offset = std::max((!shift ? getmaxy(GetWINDOW()) : getmaxx(GetWINDOW())) / 4, 1);
+		int offset = std::max((!shift ? height : width) / 4, 1);
 		if (button == 4) offset *= -1;
+		if (frameInterval.count() > 0) {
+			(!shift ? wheelLines : wheelColumns) += offset; // scroll along with the next frame
+			return true;
+		}
 		return (!shift ? ScrollTo(topLine + offset) : HorizontalScrollTo(xOffset + offset), true);
 	}
 	return false;
 }
 
 // Handles a mouse move, with coordinates relative to this window.
-// Returns whether or not the press was handled.
+// Returns whether or not the move was handled.
+// When refreshes are limited, only the last move before the next frame or other input is
+// handled, but whether it will be handled is still known.
 bool ScintillaCurses::MouseMove(int y, int x, KeyMod modifiers) {
+	STATS_SCOPE;
+	TraceSpan span("MouseMove");
 	GetWINDOW(); // ensure the curses `WINDOW` has been created
+	if (frameInterval.count() == 0) return MoveMouse(y, x, modifiers);
+	pendingMove = std::make_tuple(y, x, modifiers);
+	return draggingVScrollBar || draggingHScrollBar || HaveMouseCapture();
+}
+
+// Drags a scroll bar or has Scintilla handle a mouse move.
+bool ScintillaCurses::MoveMouse(int y, int x, KeyMod modifiers) {
 	if (!draggingVScrollBar && !draggingHScrollBar) {
 		ButtonMoveWithModifiers(Point(x, y), 0, modifiers);
 	} else if (draggingVScrollBar) {
-		int maxy = getmaxy(GetWINDOW()) - scrollBarHeight, pos = y - dragOffset;
+		int maxy = height - scrollBarHeight, pos = y - dragOffset;
 		if (pos >= 0 && pos <= maxy) ScrollTo(pos * MaxScrollPos() / maxy);
 		return true;
 	} else if (draggingHScrollBar) {
-		int maxx = getmaxx(GetWINDOW()) - scrollBarWidth, pos = x - dragOffset;
+		int maxx = width - scrollBarWidth, pos = x - dragOffset;
 		if (pos >= 0 && pos <= maxx)
 			HorizontalScrollTo(pos * (scrollWidth - maxx - scrollBarWidth) / maxx);
 		return true;
@@ -613,6 +1959,9 @@ bool ScintillaCurses::MouseMove(int y, int x, KeyMod modifiers) {
 
 // Handles a mouse button release, with coordinates relative to this window.
 void ScintillaCurses::MouseRelease(int y, int x, KeyMod modifiers) {
+	STATS_SCOPE;
+	TraceSpan span("MouseRelease");
+	FlushInput();
 	const auto now = std::chrono::system_clock::now().time_since_epoch();
 	auto time =
 		static_cast<unsigned int>(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
@@ -630,12 +1979,48 @@ void ScintillaCurses::MouseRelease(int y, int x, KeyMod modifiers) {
 // secondary X selections.
 // The caller is responsible for `free`ing the returned text.
 char *ScintillaCurses::GetClipboard(int *len) {
-	if (len) *len = static_cast<int>(clipboard.Length());
-	char *text = new char[clipboard.Length() + 1];
-	memcpy(text, clipboard.Data(), clipboard.Length() + 1);
+	if (len) *len = static_cast<int>(clipboard->Length());
+	char *text = new char[clipboard->Length() + 1];
+	memcpy(text, clipboard->Data(), clipboard->Length() + 1);
 	return text;
 }
 
+// Returns the NUL-terminated text on the internal clipboard without copying it.
+// The window holds onto the text until it borrows again or is deleted, so later copies and cuts
+// do not invalidate it.
+const char *ScintillaCurses::BorrowClipboard(size_t *len) {
+	borrowedClipboard = clipboard;
+	if (len) *len = borrowedClipboard->Length();
+	return borrowedClipboard->Data();
+}
+
+// Gets the rendering statistics for the last frame and all frames so far, returning whether or
+// not they are kept.
+bool ScintillaCurses::GetStats(ScintermStats *frame, ScintermStats *total) {
+#if SCINTERM_STATS
+	if (frame) *frame = frameStats;
+	if (total) *total = totalStats;
+	return true;
+#else
+	if (frame) *frame = {};
+	if (total) *total = {};
+	return false;
+#endif
+}
+
+// Returns the text of the given cell as last painted, along with its colors and attributes.
+const char *ScintillaCurses::GetCell(int y, int x, int *fore, int *back, attr_t *attrs) {
+	GetWINDOW(); // ensure the window has been created
+	ColourRGBA cellFore, cellBack;
+	attr_t cellAttrs = 0;
+	const std::string *text = grid.Get(y, x, cellFore, cellBack, cellAttrs);
+	if (!text) return nullptr;
+	if (fore) *fore = cellFore.OpaqueRGB();
+	if (back) *back = cellBack.OpaqueRGB();
+	if (attrs) *attrs = cellAttrs;
+	return text->c_str();
+}
+
 } // namespace Scintilla::Internal
 
 using ScintillaCurses = Scintilla::Internal::ScintillaCurses;
@@ -647,6 +2032,21 @@ void *scintilla_new(void (*callback)(void *, int, SCNotification *, void *), voi
 	return reinterpret_cast<void *>(new ScintillaCurses(callback, userdata));
 }
 
+void *scintilla_new_headless(int height, int width,
+	void (*callback)(void *, int, SCNotification *, void *), void *userdata) {
+	auto scicurses = new ScintillaCurses(callback, userdata, true);
+	scicurses->Resize(height, width);
+	return reinterpret_cast<void *>(scicurses);
+}
+
+void *scintilla_new_ansi(FILE *out, int y, int x, int height, int width,
+	void (*callback)(void *, int, SCNotification *, void *), void *userdata) {
+	auto scicurses = new ScintillaCurses(callback, userdata, true);
+	scicurses->SetAnsiOutput(out, y, x);
+	scicurses->Resize(height, width);
+	return reinterpret_cast<void *>(scicurses);
+}
+
 WINDOW *scintilla_get_window(void *sci) {
 	return reinterpret_cast<ScintillaCurses *>(sci)->GetWINDOW();
 }
@@ -656,16 +2056,34 @@ sptr_t scintilla_send_message(void *sci, unsigned int iMessage, uptr_t wParam, s
 		static_cast<Scintilla::Message>(iMessage), wParam, lParam);
 }
 
+void scintilla_send_messages(
+	void *sci, const ScintillaMessage *batch, size_t n, sptr_t *results, bool defer) {
+	reinterpret_cast<ScintillaCurses *>(sci)->SendMessages(batch, n, results, defer);
+}
+
 void scintilla_send_key(void *sci, int key, int modifiers) {
 	reinterpret_cast<ScintillaCurses *>(sci)->KeyPress(
 		key, static_cast<Scintilla::KeyMod>(modifiers));
 }
 
+void scintilla_send_text(void *sci, const char *text, size_t len, bool paste) {
+	reinterpret_cast<ScintillaCurses *>(sci)->SendText(std::string_view(text, len), paste);
+}
+
+void scintilla_show_virtual_autocomplete(void *sci, int lenEntered, int count,
+	const char *(*item)(int n, int *type, void *userdata), void *userdata) {
+	reinterpret_cast<ScintillaCurses *>(sci)->ShowVirtualAutoComplete(
+		lenEntered, count, item, userdata);
+}
+
+void scintilla_set_fuzzy_autocomplete(void *sci, bool fuzzy) {
+	reinterpret_cast<ScintillaCurses *>(sci)->SetFuzzyAutoComplete(fuzzy);
+}
+
 bool scintilla_send_mouse(void *sci, int event, int button, int modifiers, int y, int x) {
 	auto scicurses = reinterpret_cast<ScintillaCurses *>(sci);
-	WINDOW *w = scicurses->GetWINDOW();
-	int begy = getbegy(w), begx = getbegx(w);
-	int maxy = getmaxy(w), maxx = getmaxx(w);
+	int begy, begx, maxy, maxx;
+	scicurses->GetBounds(begy, begx, maxy, maxx);
 	// Ignore most events outside the window.
 	if ((x < begx || x > begx + maxx - 1 || y < begy || y > begy + maxy - 1) && button != 4 &&
 		button != 5 && event != SCM_DRAG)
@@ -684,13 +2102,54 @@ char *scintilla_get_clipboard(void *sci, int *len) {
 	return reinterpret_cast<ScintillaCurses *>(sci)->GetClipboard(len);
 }
 
+const char *scintilla_borrow_clipboard(void *sci, size_t *len) {
+	return reinterpret_cast<ScintillaCurses *>(sci)->BorrowClipboard(len);
+}
+
 void scintilla_noutrefresh(void *sci) { reinterpret_cast<ScintillaCurses *>(sci)->NoutRefresh(); }
 
 void scintilla_refresh(void *sci) { reinterpret_cast<ScintillaCurses *>(sci)->Refresh(); }
 
+void scintilla_resize(void *sci, int height, int width) {
+	reinterpret_cast<ScintillaCurses *>(sci)->Resize(height, width);
+}
+
+void scintilla_touch(void *sci) { reinterpret_cast<ScintillaCurses *>(sci)->Touch(); }
+
+bool scintilla_trace(const char *path) { return Scintilla::Internal::set_trace_file(path); }
+
+bool scintilla_get_stats(void *sci, ScintermStats *frame, ScintermStats *total) {
+	return reinterpret_cast<ScintillaCurses *>(sci)->GetStats(frame, total);
+}
+
+const char *scintilla_get_cell(void *sci, int y, int x, int *fore, int *back, attr_t *attrs) {
+	return reinterpret_cast<ScintillaCurses *>(sci)->GetCell(y, x, fore, back, attrs);
+}
+
 void scintilla_update_cursor(void *sci) {
 	reinterpret_cast<ScintillaCurses *>(sci)->UpdateCursor();
 }
 
+int scintilla_get_timeout(void *sci) {
+	return reinterpret_cast<ScintillaCurses *>(sci)->NextTimeout();
+}
+
+void scintilla_process_timers(void *sci) {
+	reinterpret_cast<ScintillaCurses *>(sci)->ProcessTimers();
+}
+
+void scintilla_set_frame_rate(void *sci, int fps) {
+	reinterpret_cast<ScintillaCurses *>(sci)->SetFrameRate(fps);
+}
+
+bool scintilla_reserve_color_pairs(int n) {
+	return Scintilla::Internal::reserve_color_pairs(n);
+}
+
+void *scintilla_new_background_lexer(void *lexer) {
+	return static_cast<Scintilla::ILexer5 *>(
+		new Scintilla::Internal::BackgroundLexer(reinterpret_cast<Scintilla::ILexer5 *>(lexer)));
+}
+
 void scintilla_delete(void *sci) { delete reinterpret_cast<ScintillaCurses *>(sci); }
 }
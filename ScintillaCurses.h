@@ -15,6 +15,8 @@ extern "C" {
 /**
  * Creates a new Scintilla window.
  * Curses does not have to be initialized before calling this function.
+ * Lines are laid out on a single thread by default; `SCI_SETLAYOUTTHREADS` lets Scintilla
+ * split the measurement of long lines across more threads.
  * @param callback A callback function for Scintilla notifications.
  * @param userdata Userdata to pass to *callback*.
  */
@@ -22,7 +24,52 @@ void *scintilla_new(
 	void (*callback)(void *sci, int iMessage, SCNotification *n, void *userdata), void *userdata);
 
 /**
- * Returns the curses `WINDOW` associated with the given Scintilla window.
+ * Creates a new headless Scintilla window that paints into memory instead of onto a curses
+ * `WINDOW`.
+ * Headless windows are refreshed like any other, and their painted cells can be read back with
+ * `scintilla_get_cell()`. They never show autocompletion lists, user lists, or call tips, and
+ * mouse events are relative to (0, 0).
+ * Curses does not have to be initialized before calling this function. If it is not, settings
+ * with alpha values are drawn opaquely.
+ * @param height The number of rows in the window.
+ * @param width The number of columns in the window.
+ * @param callback A callback function for Scintilla notifications.
+ * @param userdata Userdata to pass to *callback*.
+ */
+void *scintilla_new_headless(int height, int width,
+	void (*callback)(void *sci, int iMessage, SCNotification *n, void *userdata), void *userdata);
+
+/**
+ * Creates a new Scintilla window that writes itself to a terminal with ANSI escape sequences
+ * instead of via curses.
+ * The window remembers what the terminal is showing and writes only what changed when it is
+ * refreshed, using the shortest escape sequences it can: attribute and color changes, relative
+ * cursor movements, erasures to the end of the line, and repeated characters. This usually
+ * takes fewer bytes than curses does, which helps over slow connections.
+ * Each refresh is written with a single system call as a synchronized update (DEC mode 2026),
+ * so terminals that support them never show a partially written frame.
+ * Colors are 24-bit if the `COLORTERM` environment variable is "truecolor" or "24bit", and
+ * xterm's 256 colors otherwise.
+ * Like headless windows, these windows never show autocompletion lists, user lists, or call
+ * tips. Applications that write to the area of the terminal the window occupies (e.g. clearing
+ * the screen) should call `scintilla_touch()` afterwards so the window writes all of itself
+ * again on the next refresh.
+ * Curses does not have to be initialized before calling this function. If it is not, `ACS_*`
+ * characters like the scroll bars' are drawn as spaces.
+ * @param out The terminal to write to, usually `stdout`.
+ * @param y The terminal row of the window's top-left corner.
+ * @param x The terminal column of the window's top-left corner.
+ * @param height The number of rows in the window.
+ * @param width The number of columns in the window.
+ * @param callback A callback function for Scintilla notifications.
+ * @param userdata Userdata to pass to *callback*.
+ */
+void *scintilla_new_ansi(FILE *out, int y, int x, int height, int width,
+	void (*callback)(void *sci, int iMessage, SCNotification *n, void *userdata), void *userdata);
+
+/**
+ * Returns the curses `WINDOW` associated with the given Scintilla window, or `NULL` if that
+ * window is headless.
  * Curses must have been initialized prior to calling this function.
  * @param sci The Scintilla window returned by `scintilla_new()`.
  * @return curses `WINDOW`.
@@ -39,6 +86,32 @@ WINDOW *scintilla_get_window(void *sci);
  */
 sptr_t scintilla_send_message(void *sci, unsigned int iMessage, uptr_t wParam, sptr_t lParam);
 
+/**
+ * A message with parameters to send to a Scintilla window with `scintilla_send_messages()`.
+ */
+typedef struct {
+	unsigned int message; // the message ID
+	uptr_t wParam; // the first parameter
+	sptr_t lParam; // the second parameter
+} ScintillaMessage;
+
+/**
+ * Sends the given batch of messages with parameters to the given Scintilla window, in order.
+ * This is faster than calling `scintilla_send_message()` for each message. If a message fails,
+ * the rest are not sent and the window's status (`SCI_GETSTATUS`) reports the failure.
+ * If *defer* is `true`, notifications are held until the batch ends instead of being sent as
+ * messages generate them. Successive `SCN_UPDATEUI` notifications are combined into one.
+ * Curses does not have to be initialized before calling this function.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ * @param batch The messages to send.
+ * @param n The number of messages in *batch*.
+ * @param results An optional array of *n* elements to store the messages' results in. The
+ *   results of messages not sent are `0`.
+ * @param defer Whether or not to hold notifications until the batch ends.
+ */
+void scintilla_send_messages(
+	void *sci, const ScintillaMessage *batch, size_t n, sptr_t *results, bool defer);
+
 /**
  * Sends the specified key to the given Scintilla window for processing.
  * If it is not consumed, an SCNotification will be emitted.
@@ -49,6 +122,63 @@ sptr_t scintilla_send_message(void *sci, unsigned int iMessage, uptr_t wParam, s
  */
 void scintilla_send_key(void *sci, int key, int modifiers);
 
+/**
+ * Sends the given text to the given Scintilla window all at once, as a single undo action.
+ * This is much faster than sending each of the text's characters with `scintilla_send_key()`,
+ * especially for large bracketed pastes, since the text is inserted in bulk.
+ * Pasted text replaces the selection (or each selection, depending on `SCI_SETMULTIPASTE`) in
+ * a single insertion, with its line endings converted if `SCI_SETPASTECONVERTENDINGS` is enabled.
+ * Otherwise the text is typed as if each character had been sent by `scintilla_send_key()`,
+ * honoring overtype mode, multiple selections, and autocompletion. While neither overtype mode
+ * nor an autocompletion list is active, runs of characters are inserted at once, and
+ * `SCN_CHARADDED` is emitted only for the last character of each run; otherwise characters are
+ * typed one at a time. Line endings ("\r\n", "\r", or "\n") are typed as new lines
+ * (`SCI_NEWLINE`), and other control characters like Tab are handled as keys, ending runs.
+ * Curses does not have to be initialized before calling this function.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ * @param text The text to send, in Scintilla's code page.
+ * @param len The length of *text* in bytes.
+ * @param paste Whether to paste *text* instead of typing it.
+ */
+void scintilla_send_text(void *sci, const char *text, size_t len, bool paste);
+
+/**
+ * Shows an autocompletion list whose items are fetched on demand, like `SCI_AUTOCSHOW` does
+ * with a list of items, but without building or copying that list.
+ * Only the items the window needs are fetched: those shown on screen, those that Scintilla's
+ * binary search looks at as the user types, and the first 100 in order to size the list.
+ * Since Scintilla binary searches the list, items must be sorted regardless of
+ * `SCI_AUTOCSETORDER`. Lists shown by `SCI_AUTOCSHOW` or `SCI_USERLISTSHOW` afterwards are
+ * normal lists again.
+ * Curses must have been initialized prior to calling this function, unless the window is
+ * headless.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ * @param lenEntered The number of characters before the caret that have been entered, as for
+ *   `SCI_AUTOCSHOW`.
+ * @param count The number of items in the list.
+ * @param item A function that returns the text of item *n* (counting from 0), which must stay
+ *   valid until the function is called again, and stores the item's registered image type (or
+ *   -1 for none) in *type*.
+ * @param userdata Userdata to pass to *item*.
+ */
+void scintilla_show_virtual_autocomplete(void *sci, int lenEntered, int count,
+	const char *(*item)(int n, int *type, void *userdata), void *userdata);
+
+/**
+ * Sets whether the given Scintilla window falls back on fuzzy matching when no item in an
+ * autocompletion or user list starts with the word being completed.
+ * Instead of selecting nothing or hiding the list, the window shows only the items that match
+ * the word as a subsequence, ignoring case (e.g. "gfn" matches "get_file_name"), and selects
+ * the best match. Items whose matching characters are consecutive or start words are listed
+ * first. If no item matches, the list is hidden or nothing is selected, depending on
+ * `SCI_AUTOCSETAUTOHIDE`.
+ * Fuzzy matching is disabled by default.
+ * Curses does not have to be initialized before calling this function.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ * @param fuzzy Whether to fall back on fuzzy matching.
+ */
+void scintilla_set_fuzzy_autocomplete(void *sci, bool fuzzy);
+
 /**
  * Sends the specified mouse event to the given Scintilla window for processing.
  * Curses must have been initialized prior to calling this function.
@@ -74,10 +204,26 @@ bool scintilla_send_mouse(void *sci, int event, int button, int modifiers, int y
  */
 char *scintilla_get_clipboard(void *sci, int *len);
 
+/**
+ * Returns the NUL-terminated text on Scintilla's internal clipboard without copying it.
+ * All Scintilla windows share the same clipboard.
+ * The returned text must not be modified or freed. It remains valid until the next call to this
+ * function for the same Scintilla window or until that window is deleted, even if the clipboard
+ * changes in the meantime.
+ * Keep in mind clipboard text may contain NUL bytes.
+ * Curses does not have to be initialized before calling this function.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ * @param len An optional pointer to store the length of the returned text in.
+ * @return the clipboard text.
+ */
+const char *scintilla_borrow_clipboard(void *sci, size_t *len);
+
 /**
  * Refreshes the Scintilla window on the virtual screen.
  * This should be done along with the normal curses `noutrefresh()`, as the virtual screen is
  * updated when calling this function.
+ * Only the areas of the window that Scintilla invalidated since the last refresh are repainted.
+ * If the application draws over the window, it must call `scintilla_touch()` first.
  * Curses must have been initialized prior to calling this function.
  * Note: the terminal cursor may be hidden if Scintilla thinks this window has focus
  * (e.g. `SCI_SETFOCUS`) and Scintilla's caret is out of view. If another non-Scintilla window
@@ -98,6 +244,94 @@ void scintilla_noutrefresh(void *sci);
  */
 void scintilla_refresh(void *sci);
 
+/**
+ * Resizes the given Scintilla window.
+ * Scintilla adapts to the new size on the next refresh, which writes all of the window again
+ * even if its size did not change, like after `scintilla_touch()`.
+ * Curses must have been initialized prior to calling this function, unless the window is
+ * headless.
+ * @param sci The Scintilla window returned by `scintilla_new()` or `scintilla_new_headless()`.
+ * @param height The number of rows in the window.
+ * @param width The number of columns in the window.
+ */
+void scintilla_resize(void *sci, int height, int width);
+
+/**
+ * Marks all of the given Scintilla window as changed, so the next refresh repaints it and
+ * writes all of it to the virtual screen (or terminal) again.
+ * Refreshes normally only write what changed since the last one, so applications must call
+ * this after drawing over the window's area, e.g. after clearing the screen, refreshing an
+ * overlapping window, or closing a dialog that covered it.
+ * Curses must have been initialized prior to calling this function, unless the window is
+ * headless.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ */
+void scintilla_touch(void *sci);
+
+/**
+ * Returns the text of the given cell of the Scintilla window as of the last refresh, along with
+ * its colors and attributes.
+ * This is mainly useful for headless windows.
+ * The text is a UTF-8 character along with any combining characters that follow it, or an empty
+ * string for the right half of a wide character. Cells with the `A_ALTCHARSET` attribute hold
+ * the character of a curses `ACS_*` character instead (e.g. "q" for `ACS_HLINE`).
+ * The returned text is only valid until the next refresh.
+ * @param sci The Scintilla window returned by `scintilla_new()` or `scintilla_new_headless()`.
+ * @param y The row of the cell.
+ * @param x The column of the cell.
+ * @param fore An optional pointer to store the cell's foreground color in, in "0xBBGGRR" format.
+ * @param back An optional pointer to store the cell's background color in, in "0xBBGGRR" format.
+ * @param attrs An optional pointer to store the cell's curses attributes in (e.g. `A_BOLD`).
+ * @return cell text, or `NULL` if the cell is outside the window.
+ */
+const char *scintilla_get_cell(void *sci, int y, int x, int *fore, int *back, attr_t *attrs);
+
+/**
+ * Rendering statistics for a Scintilla window, as returned by `scintilla_get_stats()`.
+ */
+typedef struct {
+	unsigned long paint_us; // microseconds spent in `scintilla_noutrefresh()`
+	unsigned long rows_painted; // window rows Scintilla repainted
+	unsigned long text_measures; // text measurements, most of them made while laying out lines
+	unsigned long text_draws; // text drawing calls, like `DrawTextNoClip()`
+	unsigned long rectangle_fills; // `FillRectangle()` calls
+	unsigned long alpha_rectangles; // `AlphaRectangle()` calls, e.g. for translucent selections
+	unsigned long grapheme_clusters; // non-ASCII grapheme clusters measured
+	unsigned long cells_written; // cells written to curses windows
+	unsigned long bytes_written; // bytes of text written to curses windows
+	unsigned long notifications; // notifications sent to the callback
+} ScintermStats;
+
+/**
+ * Gets the rendering statistics of the given Scintilla window for its last frame and in total.
+ * A frame is everything done on behalf of the window since the previous refresh, up to and
+ * including the latest `scintilla_noutrefresh()` or `scintilla_refresh()`.
+ * Statistics are only kept if Scinterm was compiled with them (`make STATS=1`). Otherwise,
+ * this function returns `false` and the statistics are all `0`.
+ * Curses does not have to be initialized before calling this function.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ * @param frame An optional pointer to store the statistics of the last frame in.
+ * @param total An optional pointer to store the statistics of all frames so far in.
+ * @return whether or not statistics are kept
+ */
+bool scintilla_get_stats(void *sci, ScintermStats *frame, ScintermStats *total);
+
+/**
+ * Starts writing trace events for all Scintilla windows to the given file, or stops if it is
+ * `NULL`.
+ * Events are spans of time spent handling keys, mouse events, and messages, painting, drawing
+ * scroll bars and popups, writing to curses, calling `doupdate()`, and lexing in the background.
+ * Spans nest, so a slow frame can be broken down into where its time went. The file is a Chrome
+ * trace event JSON array that chrome://tracing and Perfetto (https://ui.perfetto.dev) can load.
+ * Starting a new trace or stopping ends any current one.
+ * Alternatively, set the `SCINTERM_TRACE` environment variable to a file name before creating
+ * the first Scintilla window.
+ * Curses does not have to be initialized before calling this function.
+ * @param path The file to write trace events to, or `NULL`.
+ * @return whether or not the file could be opened
+ */
+bool scintilla_trace(const char *path);
+
 /**
  * Updates the curses window cursor for the Scintilla window so the terminal draws the cursor
  * in the correct position.
@@ -109,6 +343,76 @@ void scintilla_refresh(void *sci);
  */
 void scintilla_update_cursor(void *sci);
 
+/**
+ * Returns the number of milliseconds until the given Scintilla window's next timer or put off
+ * frame is due, `0` if it has idle work to do, or `-1` if it is not waiting on anything.
+ * Timers drive things like autoscrolling while selecting with the mouse, dwell notifications,
+ * and idle styling (`SCI_SETIDLESTYLING`). Applications should wait for input for no longer
+ * than this (e.g. via `poll()`, `select()`, or curses' `timeout()`) and then call
+ * `scintilla_process_timers()`.
+ * Curses does not have to be initialized before calling this function.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ * @return number of milliseconds, `0`, or `-1`
+ */
+int scintilla_get_timeout(void *sci);
+
+/**
+ * Runs the given Scintilla window's timers that are due, along with a slice of any idle work.
+ * Call `scintilla_noutrefresh()` or `scintilla_refresh()` afterwards in order to show any changes.
+ * Curses must have been initialized prior to calling this function.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ */
+void scintilla_process_timers(void *sci);
+
+/**
+ * Limits how often the given Scintilla window refreshes, so that bursts of input (e.g. held down
+ * keys, pastes, and mouse drags) do not paint frames nobody sees.
+ * A refresh less than a *fps*th of a second after the last painted frame paints nothing,
+ * and `scintilla_get_timeout()` instead returns when the next frame is due, so applications that
+ * refresh after calling `scintilla_process_timers()` paint it then. Until then, consecutive
+ * mouse wheel scrolls are added together and only the last mouse move is handled. Other input
+ * is handled as usual, and handles any coalesced input first.
+ * By default, refreshes are not limited.
+ * Curses does not have to be initialized before calling this function.
+ * @param sci The Scintilla window returned by `scintilla_new()`.
+ * @param fps The maximum number of frames per second, or `0` for no limit.
+ */
+void scintilla_set_frame_rate(void *sci, int fps);
+
+/**
+ * Returns a lexer that styles and folds with the given lexer on a worker thread, instead of
+ * while Scintilla paints, for passing to `SCI_SETILEXER`.
+ * The worker styles a copy of the document's text, starting with the first unstyled line and
+ * continuing past the end of the view to the end of the document. That copy is made a part at
+ * a time, so it takes about as long for any document size. Text changes cancel that work. The
+ * styles it produces are applied by `scintilla_process_timers()`, so applications using this
+ * lexer must call that function when `scintilla_get_timeout()` says to. Until then, unstyled
+ * text is drawn in the default style.
+ * Only painting waits for the worker. Anything else that needs styled text (e.g.
+ * `SCI_COLOURISE`, brace matching, and idle styling) cancels the worker and styles right away
+ * with the wrapped lexer.
+ * Lexers that set indicators cannot do so from the worker thread.
+ * Curses does not have to be initialized before calling this function.
+ * @param lexer The `ILexer5` to wrap, usually from Lexilla's `CreateLexer()`. The returned
+ *   lexer takes ownership of it.
+ * @return `ILexer5` pointer.
+ */
+void *scintilla_new_background_lexer(void *lexer);
+
+/**
+ * Reserves curses color pairs 1 through *n* for the application.
+ * Scintilla defines color pairs as it needs them, starting with pair 1, and redefines the least
+ * recently used pair that nothing on screen shows when the terminal runs out of them. It never
+ * defines reserved pairs, so applications that define their own pairs with `init_pair()` must
+ * reserve them. Otherwise, Scintilla may redefine those pairs and recolor what the application
+ * drew with them.
+ * This must be called before the first Scintilla window is refreshed, which initializes colors.
+ * Later calls have no effect and return `false`.
+ * @param n The number of color pairs to reserve.
+ * @return whether or not the pairs were reserved
+ */
+bool scintilla_reserve_color_pairs(int n);
+
 /**
  * Deletes the given Scintilla window.
  * Curses must have been initialized prior to calling this function.
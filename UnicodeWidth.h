@@ -0,0 +1,636 @@
+// Copyright 2012-2024 Mitchell. See LICENSE.
+// Terminal cell classes of Unicode code points for measuring text.
+// Generated by scripts/GenerateUnicodeWidth.py from Unicode 15.1.0. Do not edit.
+
+#ifndef UNICODE_WIDTH_H
+#define UNICODE_WIDTH_H
+
+namespace Scintilla::Internal {
+
+/**
+ * Classes of code points, as far as terminal cell widths and grapheme cluster boundaries
+ * are concerned.
+ */
+enum class CellClass : unsigned char {
+	Narrow, // a single cell
+	Wide, // two cells
+	Extend, // extends the preceding grapheme cluster, taking up no cells
+	ZWJ, // zero width joiner, which joins pictographs
+	RegionalIndicator, // a single cell, or two when paired into a flag
+	Pictographic, // a single cell, or two when followed by an emoji variation selector
+	PictographicWide, // two cells
+	Control // a single cell, never extended
+};
+
+struct CellClassRange {
+	char32_t first;
+	char32_t last;
+	CellClass cellClass;
+};
+
+// Ranges of code points that are not `CellClass::Narrow`, in order.
+constexpr CellClassRange cellClassRanges[] = {
+	{0x0000, 0x001F, CellClass::Control},
+	{0x007F, 0x009F, CellClass::Control},
+	{0x00A9, 0x00A9, CellClass::Pictographic},
+	{0x00AE, 0x00AE, CellClass::Pictographic},
+	{0x0300, 0x036F, CellClass::Extend},
+	{0x0483, 0x0489, CellClass::Extend},
+	{0x0591, 0x05BD, CellClass::Extend},
+	{0x05BF, 0x05BF, CellClass::Extend},
+	{0x05C1, 0x05C2, CellClass::Extend},
+	{0x05C4, 0x05C5, CellClass::Extend},
+	{0x05C7, 0x05C7, CellClass::Extend},
+	{0x0610, 0x061A, CellClass::Extend},
+	{0x061C, 0x061C, CellClass::Extend},
+	{0x064B, 0x065F, CellClass::Extend},
+	{0x0670, 0x0670, CellClass::Extend},
+	{0x06D6, 0x06DC, CellClass::Extend},
+	{0x06DF, 0x06E4, CellClass::Extend},
+	{0x06E7, 0x06E8, CellClass::Extend},
+	{0x06EA, 0x06ED, CellClass::Extend},
+	{0x0711, 0x0711, CellClass::Extend},
+	{0x0730, 0x074A, CellClass::Extend},
+	{0x07A6, 0x07B0, CellClass::Extend},
+	{0x07EB, 0x07F3, CellClass::Extend},
+	{0x07FD, 0x07FD, CellClass::Extend},
+	{0x0816, 0x0819, CellClass::Extend},
+	{0x081B, 0x0823, CellClass::Extend},
+	{0x0825, 0x0827, CellClass::Extend},
+	{0x0829, 0x082D, CellClass::Extend},
+	{0x0859, 0x085B, CellClass::Extend},
+	{0x0898, 0x089F, CellClass::Extend},
+	{0x08CA, 0x08E1, CellClass::Extend},
+	{0x08E3, 0x0902, CellClass::Extend},
+	{0x093A, 0x093A, CellClass::Extend},
+	{0x093C, 0x093C, CellClass::Extend},
+	{0x0941, 0x0948, CellClass::Extend},
+	{0x094D, 0x094D, CellClass::Extend},
+	{0x0951, 0x0957, CellClass::Extend},
+	{0x0962, 0x0963, CellClass::Extend},
+	{0x0981, 0x0981, CellClass::Extend},
+	{0x09BC, 0x09BC, CellClass::Extend},
+	{0x09C1, 0x09C4, CellClass::Extend},
+	{0x09CD, 0x09CD, CellClass::Extend},
+	{0x09E2, 0x09E3, CellClass::Extend},
+	{0x09FE, 0x09FE, CellClass::Extend},
+	{0x0A01, 0x0A02, CellClass::Extend},
+	{0x0A3C, 0x0A3C, CellClass::Extend},
+	{0x0A41, 0x0A42, CellClass::Extend},
+	{0x0A47, 0x0A48, CellClass::Extend},
+	{0x0A4B, 0x0A4D, CellClass::Extend},
+	{0x0A51, 0x0A51, CellClass::Extend},
+	{0x0A70, 0x0A71, CellClass::Extend},
+	{0x0A75, 0x0A75, CellClass::Extend},
+	{0x0A81, 0x0A82, CellClass::Extend},
+	{0x0ABC, 0x0ABC, CellClass::Extend},
+	{0x0AC1, 0x0AC5, CellClass::Extend},
+	{0x0AC7, 0x0AC8, CellClass::Extend},
+	{0x0ACD, 0x0ACD, CellClass::Extend},
+	{0x0AE2, 0x0AE3, CellClass::Extend},
+	{0x0AFA, 0x0AFF, CellClass::Extend},
+	{0x0B01, 0x0B01, CellClass::Extend},
+	{0x0B3C, 0x0B3C, CellClass::Extend},
+	{0x0B3F, 0x0B3F, CellClass::Extend},
+	{0x0B41, 0x0B44, CellClass::Extend},
+	{0x0B4D, 0x0B4D, CellClass::Extend},
+	{0x0B55, 0x0B56, CellClass::Extend},
+	{0x0B62, 0x0B63, CellClass::Extend},
+	{0x0B82, 0x0B82, CellClass::Extend},
+	{0x0BC0, 0x0BC0, CellClass::Extend},
+	{0x0BCD, 0x0BCD, CellClass::Extend},
+	{0x0C00, 0x0C00, CellClass::Extend},
+	{0x0C04, 0x0C04, CellClass::Extend},
+	{0x0C3C, 0x0C3C, CellClass::Extend},
+	{0x0C3E, 0x0C40, CellClass::Extend},
+	{0x0C46, 0x0C48, CellClass::Extend},
+	{0x0C4A, 0x0C4D, CellClass::Extend},
+	{0x0C55, 0x0C56, CellClass::Extend},
+	{0x0C62, 0x0C63, CellClass::Extend},
+	{0x0C81, 0x0C81, CellClass::Extend},
+	{0x0CBC, 0x0CBC, CellClass::Extend},
+	{0x0CBF, 0x0CBF, CellClass::Extend},
+	{0x0CC6, 0x0CC6, CellClass::Extend},
+	{0x0CCC, 0x0CCD, CellClass::Extend},
+	{0x0CE2, 0x0CE3, CellClass::Extend},
+	{0x0D00, 0x0D01, CellClass::Extend},
+	{0x0D3B, 0x0D3C, CellClass::Extend},
+	{0x0D41, 0x0D44, CellClass::Extend},
+	{0x0D4D, 0x0D4D, CellClass::Extend},
+	{0x0D62, 0x0D63, CellClass::Extend},
+	{0x0D81, 0x0D81, CellClass::Extend},
+	{0x0DCA, 0x0DCA, CellClass::Extend},
+	{0x0DD2, 0x0DD4, CellClass::Extend},
+	{0x0DD6, 0x0DD6, CellClass::Extend},
+	{0x0E31, 0x0E31, CellClass::Extend},
+	{0x0E34, 0x0E3A, CellClass::Extend},
+	{0x0E47, 0x0E4E, CellClass::Extend},
+	{0x0EB1, 0x0EB1, CellClass::Extend},
+	{0x0EB4, 0x0EBC, CellClass::Extend},
+	{0x0EC8, 0x0ECE, CellClass::Extend},
+	{0x0F18, 0x0F19, CellClass::Extend},
+	{0x0F35, 0x0F35, CellClass::Extend},
+	{0x0F37, 0x0F37, CellClass::Extend},
+	{0x0F39, 0x0F39, CellClass::Extend},
+	{0x0F71, 0x0F7E, CellClass::Extend},
+	{0x0F80, 0x0F84, CellClass::Extend},
+	{0x0F86, 0x0F87, CellClass::Extend},
+	{0x0F8D, 0x0F97, CellClass::Extend},
+	{0x0F99, 0x0FBC, CellClass::Extend},
+	{0x0FC6, 0x0FC6, CellClass::Extend},
+	{0x102D, 0x1030, CellClass::Extend},
+	{0x1032, 0x1037, CellClass::Extend},
+	{0x1039, 0x103A, CellClass::Extend},
+	{0x103D, 0x103E, CellClass::Extend},
+	{0x1058, 0x1059, CellClass::Extend},
+	{0x105E, 0x1060, CellClass::Extend},
+	{0x1071, 0x1074, CellClass::Extend},
+	{0x1082, 0x1082, CellClass::Extend},
+	{0x1085, 0x1086, CellClass::Extend},
+	{0x108D, 0x108D, CellClass::Extend},
+	{0x109D, 0x109D, CellClass::Extend},
+	{0x1100, 0x115F, CellClass::Wide},
+	{0x1160, 0x11FF, CellClass::Extend},
+	{0x135D, 0x135F, CellClass::Extend},
+	{0x1712, 0x1714, CellClass::Extend},
+	{0x1732, 0x1733, CellClass::Extend},
+	{0x1752, 0x1753, CellClass::Extend},
+	{0x1772, 0x1773, CellClass::Extend},
+	{0x17B4, 0x17B5, CellClass::Extend},
+	{0x17B7, 0x17BD, CellClass::Extend},
+	{0x17C6, 0x17C6, CellClass::Extend},
+	{0x17C9, 0x17D3, CellClass::Extend},
+	{0x17DD, 0x17DD, CellClass::Extend},
+	{0x180B, 0x180F, CellClass::Extend},
+	{0x1885, 0x1886, CellClass::Extend},
+	{0x18A9, 0x18A9, CellClass::Extend},
+	{0x1920, 0x1922, CellClass::Extend},
+	{0x1927, 0x1928, CellClass::Extend},
+	{0x1932, 0x1932, CellClass::Extend},
+	{0x1939, 0x193B, CellClass::Extend},
+	{0x1A17, 0x1A18, CellClass::Extend},
+	{0x1A1B, 0x1A1B, CellClass::Extend},
+	{0x1A56, 0x1A56, CellClass::Extend},
+	{0x1A58, 0x1A5E, CellClass::Extend},
+	{0x1A60, 0x1A60, CellClass::Extend},
+	{0x1A62, 0x1A62, CellClass::Extend},
+	{0x1A65, 0x1A6C, CellClass::Extend},
+	{0x1A73, 0x1A7C, CellClass::Extend},
+	{0x1A7F, 0x1A7F, CellClass::Extend},
+	{0x1AB0, 0x1ACE, CellClass::Extend},
+	{0x1B00, 0x1B03, CellClass::Extend},
+	{0x1B34, 0x1B34, CellClass::Extend},
+	{0x1B36, 0x1B3A, CellClass::Extend},
+	{0x1B3C, 0x1B3C, CellClass::Extend},
+	{0x1B42, 0x1B42, CellClass::Extend},
+	{0x1B6B, 0x1B73, CellClass::Extend},
+	{0x1B80, 0x1B81, CellClass::Extend},
+	{0x1BA2, 0x1BA5, CellClass::Extend},
+	{0x1BA8, 0x1BA9, CellClass::Extend},
+	{0x1BAB, 0x1BAD, CellClass::Extend},
+	{0x1BE6, 0x1BE6, CellClass::Extend},
+	{0x1BE8, 0x1BE9, CellClass::Extend},
+	{0x1BED, 0x1BED, CellClass::Extend},
+	{0x1BEF, 0x1BF1, CellClass::Extend},
+	{0x1C2C, 0x1C33, CellClass::Extend},
+	{0x1C36, 0x1C37, CellClass::Extend},
+	{0x1CD0, 0x1CD2, CellClass::Extend},
+	{0x1CD4, 0x1CE0, CellClass::Extend},
+	{0x1CE2, 0x1CE8, CellClass::Extend},
+	{0x1CED, 0x1CED, CellClass::Extend},
+	{0x1CF4, 0x1CF4, CellClass::Extend},
+	{0x1CF8, 0x1CF9, CellClass::Extend},
+	{0x1DC0, 0x1DFF, CellClass::Extend},
+	{0x200B, 0x200C, CellClass::Extend},
+	{0x200D, 0x200D, CellClass::ZWJ},
+	{0x200E, 0x200F, CellClass::Extend},
+	{0x202A, 0x202E, CellClass::Extend},
+	{0x203C, 0x203C, CellClass::Pictographic},
+	{0x2049, 0x2049, CellClass::Pictographic},
+	{0x2060, 0x2064, CellClass::Extend},
+	{0x2066, 0x206F, CellClass::Extend},
+	{0x20D0, 0x20F0, CellClass::Extend},
+	{0x2122, 0x2122, CellClass::Pictographic},
+	{0x2139, 0x2139, CellClass::Pictographic},
+	{0x2194, 0x2199, CellClass::Pictographic},
+	{0x21A9, 0x21AA, CellClass::Pictographic},
+	{0x231A, 0x231B, CellClass::PictographicWide},
+	{0x2328, 0x2328, CellClass::Pictographic},
+	{0x2329, 0x232A, CellClass::Wide},
+	{0x2388, 0x2388, CellClass::Pictographic},
+	{0x23CF, 0x23CF, CellClass::Pictographic},
+	{0x23E9, 0x23EC, CellClass::PictographicWide},
+	{0x23ED, 0x23EF, CellClass::Pictographic},
+	{0x23F0, 0x23F0, CellClass::PictographicWide},
+	{0x23F1, 0x23F2, CellClass::Pictographic},
+	{0x23F3, 0x23F3, CellClass::PictographicWide},
+	{0x23F8, 0x23FA, CellClass::Pictographic},
+	{0x24C2, 0x24C2, CellClass::Pictographic},
+	{0x25AA, 0x25AB, CellClass::Pictographic},
+	{0x25B6, 0x25B6, CellClass::Pictographic},
+	{0x25C0, 0x25C0, CellClass::Pictographic},
+	{0x25FB, 0x25FC, CellClass::Pictographic},
+	{0x25FD, 0x25FE, CellClass::PictographicWide},
+	{0x2600, 0x2605, CellClass::Pictographic},
+	{0x2607, 0x2612, CellClass::Pictographic},
+	{0x2614, 0x2615, CellClass::PictographicWide},
+	{0x2616, 0x2647, CellClass::Pictographic},
+	{0x2648, 0x2653, CellClass::PictographicWide},
+	{0x2654, 0x267E, CellClass::Pictographic},
+	{0x267F, 0x267F, CellClass::PictographicWide},
+	{0x2680, 0x2685, CellClass::Pictographic},
+	{0x2690, 0x2692, CellClass::Pictographic},
+	{0x2693, 0x2693, CellClass::PictographicWide},
+	{0x2694, 0x26A0, CellClass::Pictographic},
+	{0x26A1, 0x26A1, CellClass::PictographicWide},
+	{0x26A2, 0x26A9, CellClass::Pictographic},
+	{0x26AA, 0x26AB, CellClass::PictographicWide},
+	{0x26AC, 0x26BC, CellClass::Pictographic},
+	{0x26BD, 0x26BE, CellClass::PictographicWide},
+	{0x26BF, 0x26C3, CellClass::Pictographic},
+	{0x26C4, 0x26C5, CellClass::PictographicWide},
+	{0x26C6, 0x26CD, CellClass::Pictographic},
+	{0x26CE, 0x26CE, CellClass::PictographicWide},
+	{0x26CF, 0x26D3, CellClass::Pictographic},
+	{0x26D4, 0x26D4, CellClass::PictographicWide},
+	{0x26D5, 0x26E9, CellClass::Pictographic},
+	{0x26EA, 0x26EA, CellClass::PictographicWide},
+	{0x26EB, 0x26F1, CellClass::Pictographic},
+	{0x26F2, 0x26F3, CellClass::PictographicWide},
+	{0x26F4, 0x26F4, CellClass::Pictographic},
+	{0x26F5, 0x26F5, CellClass::PictographicWide},
+	{0x26F6, 0x26F9, CellClass::Pictographic},
+	{0x26FA, 0x26FA, CellClass::PictographicWide},
+	{0x26FB, 0x26FC, CellClass::Pictographic},
+	{0x26FD, 0x26FD, CellClass::PictographicWide},
+	{0x26FE, 0x2704, CellClass::Pictographic},
+	{0x2705, 0x2705, CellClass::PictographicWide},
+	{0x2708, 0x2709, CellClass::Pictographic},
+	{0x270A, 0x270B, CellClass::PictographicWide},
+	{0x270C, 0x2712, CellClass::Pictographic},
+	{0x2714, 0x2714, CellClass::Pictographic},
+	{0x2716, 0x2716, CellClass::Pictographic},
+	{0x271D, 0x271D, CellClass::Pictographic},
+	{0x2721, 0x2721, CellClass::Pictographic},
+	{0x2728, 0x2728, CellClass::PictographicWide},
+	{0x2733, 0x2734, CellClass::Pictographic},
+	{0x2744, 0x2744, CellClass::Pictographic},
+	{0x2747, 0x2747, CellClass::Pictographic},
+	{0x274C, 0x274C, CellClass::PictographicWide},
+	{0x274E, 0x274E, CellClass::PictographicWide},
+	{0x2753, 0x2755, CellClass::PictographicWide},
+	{0x2757, 0x2757, CellClass::PictographicWide},
+	{0x2763, 0x2767, CellClass::Pictographic},
+	{0x2795, 0x2797, CellClass::PictographicWide},
+	{0x27A1, 0x27A1, CellClass::Pictographic},
+	{0x27B0, 0x27B0, CellClass::PictographicWide},
+	{0x27BF, 0x27BF, CellClass::PictographicWide},
+	{0x2934, 0x2935, CellClass::Pictographic},
+	{0x2B05, 0x2B07, CellClass::Pictographic},
+	{0x2B1B, 0x2B1C, CellClass::PictographicWide},
+	{0x2B50, 0x2B50, CellClass::PictographicWide},
+	{0x2B55, 0x2B55, CellClass::PictographicWide},
+	{0x2CEF, 0x2CF1, CellClass::Extend},
+	{0x2D7F, 0x2D7F, CellClass::Extend},
+	{0x2DE0, 0x2DFF, CellClass::Extend},
+	{0x2E80, 0x2E99, CellClass::Wide},
+	{0x2E9B, 0x2EF3, CellClass::Wide},
+	{0x2F00, 0x2FD5, CellClass::Wide},
+	{0x2FF0, 0x3029, CellClass::Wide},
+	{0x302A, 0x302D, CellClass::Extend},
+	{0x302E, 0x302F, CellClass::Wide},
+	{0x3030, 0x3030, CellClass::PictographicWide},
+	{0x3031, 0x303C, CellClass::Wide},
+	{0x303D, 0x303D, CellClass::PictographicWide},
+	{0x303E, 0x303E, CellClass::Wide},
+	{0x3041, 0x3096, CellClass::Wide},
+	{0x3099, 0x309A, CellClass::Extend},
+	{0x309B, 0x30FF, CellClass::Wide},
+	{0x3105, 0x312F, CellClass::Wide},
+	{0x3131, 0x318E, CellClass::Wide},
+	{0x3190, 0x31E3, CellClass::Wide},
+	{0x31EF, 0x321E, CellClass::Wide},
+	{0x3220, 0x3247, CellClass::Wide},
+	{0x3250, 0x3296, CellClass::Wide},
+	{0x3297, 0x3297, CellClass::PictographicWide},
+	{0x3298, 0x3298, CellClass::Wide},
+	{0x3299, 0x3299, CellClass::PictographicWide},
+	{0x329A, 0x4DBF, CellClass::Wide},
+	{0x4E00, 0xA48C, CellClass::Wide},
+	{0xA490, 0xA4C6, CellClass::Wide},
+	{0xA66F, 0xA672, CellClass::Extend},
+	{0xA674, 0xA67D, CellClass::Extend},
+	{0xA69E, 0xA69F, CellClass::Extend},
+	{0xA6F0, 0xA6F1, CellClass::Extend},
+	{0xA802, 0xA802, CellClass::Extend},
+	{0xA806, 0xA806, CellClass::Extend},
+	{0xA80B, 0xA80B, CellClass::Extend},
+	{0xA825, 0xA826, CellClass::Extend},
+	{0xA82C, 0xA82C, CellClass::Extend},
+	{0xA8C4, 0xA8C5, CellClass::Extend},
+	{0xA8E0, 0xA8F1, CellClass::Extend},
+	{0xA8FF, 0xA8FF, CellClass::Extend},
+	{0xA926, 0xA92D, CellClass::Extend},
+	{0xA947, 0xA951, CellClass::Extend},
+	{0xA960, 0xA97C, CellClass::Wide},
+	{0xA980, 0xA982, CellClass::Extend},
+	{0xA9B3, 0xA9B3, CellClass::Extend},
+	{0xA9B6, 0xA9B9, CellClass::Extend},
+	{0xA9BC, 0xA9BD, CellClass::Extend},
+	{0xA9E5, 0xA9E5, CellClass::Extend},
+	{0xAA29, 0xAA2E, CellClass::Extend},
+	{0xAA31, 0xAA32, CellClass::Extend},
+	{0xAA35, 0xAA36, CellClass::Extend},
+	{0xAA43, 0xAA43, CellClass::Extend},
+	{0xAA4C, 0xAA4C, CellClass::Extend},
+	{0xAA7C, 0xAA7C, CellClass::Extend},
+	{0xAAB0, 0xAAB0, CellClass::Extend},
+	{0xAAB2, 0xAAB4, CellClass::Extend},
+	{0xAAB7, 0xAAB8, CellClass::Extend},
+	{0xAABE, 0xAABF, CellClass::Extend},
+	{0xAAC1, 0xAAC1, CellClass::Extend},
+	{0xAAEC, 0xAAED, CellClass::Extend},
+	{0xAAF6, 0xAAF6, CellClass::Extend},
+	{0xABE5, 0xABE5, CellClass::Extend},
+	{0xABE8, 0xABE8, CellClass::Extend},
+	{0xABED, 0xABED, CellClass::Extend},
+	{0xAC00, 0xD7A3, CellClass::Wide},
+	{0xD7B0, 0xD7FF, CellClass::Extend},
+	{0xF900, 0xFAFF, CellClass::Wide},
+	{0xFB1E, 0xFB1E, CellClass::Extend},
+	{0xFE00, 0xFE0F, CellClass::Extend},
+	{0xFE10, 0xFE19, CellClass::Wide},
+	{0xFE20, 0xFE2F, CellClass::Extend},
+	{0xFE30, 0xFE52, CellClass::Wide},
+	{0xFE54, 0xFE66, CellClass::Wide},
+	{0xFE68, 0xFE6B, CellClass::Wide},
+	{0xFEFF, 0xFEFF, CellClass::Extend},
+	{0xFF01, 0xFF60, CellClass::Wide},
+	{0xFFE0, 0xFFE6, CellClass::Wide},
+	{0xFFF9, 0xFFFB, CellClass::Extend},
+	{0x101FD, 0x101FD, CellClass::Extend},
+	{0x102E0, 0x102E0, CellClass::Extend},
+	{0x10376, 0x1037A, CellClass::Extend},
+	{0x10A01, 0x10A03, CellClass::Extend},
+	{0x10A05, 0x10A06, CellClass::Extend},
+	{0x10A0C, 0x10A0F, CellClass::Extend},
+	{0x10A38, 0x10A3A, CellClass::Extend},
+	{0x10A3F, 0x10A3F, CellClass::Extend},
+	{0x10AE5, 0x10AE6, CellClass::Extend},
+	{0x10D24, 0x10D27, CellClass::Extend},
+	{0x10EAB, 0x10EAC, CellClass::Extend},
+	{0x10EFD, 0x10EFF, CellClass::Extend},
+	{0x10F46, 0x10F50, CellClass::Extend},
+	{0x10F82, 0x10F85, CellClass::Extend},
+	{0x11001, 0x11001, CellClass::Extend},
+	{0x11038, 0x11046, CellClass::Extend},
+	{0x11070, 0x11070, CellClass::Extend},
+	{0x11073, 0x11074, CellClass::Extend},
+	{0x1107F, 0x11081, CellClass::Extend},
+	{0x110B3, 0x110B6, CellClass::Extend},
+	{0x110B9, 0x110BA, CellClass::Extend},
+	{0x110C2, 0x110C2, CellClass::Extend},
+	{0x11100, 0x11102, CellClass::Extend},
+	{0x11127, 0x1112B, CellClass::Extend},
+	{0x1112D, 0x11134, CellClass::Extend},
+	{0x11173, 0x11173, CellClass::Extend},
+	{0x11180, 0x11181, CellClass::Extend},
+	{0x111B6, 0x111BE, CellClass::Extend},
+	{0x111C9, 0x111CC, CellClass::Extend},
+	{0x111CF, 0x111CF, CellClass::Extend},
+	{0x1122F, 0x11231, CellClass::Extend},
+	{0x11234, 0x11234, CellClass::Extend},
+	{0x11236, 0x11237, CellClass::Extend},
+	{0x1123E, 0x1123E, CellClass::Extend},
+	{0x11241, 0x11241, CellClass::Extend},
+	{0x112DF, 0x112DF, CellClass::Extend},
+	{0x112E3, 0x112EA, CellClass::Extend},
+	{0x11300, 0x11301, CellClass::Extend},
+	{0x1133B, 0x1133C, CellClass::Extend},
+	{0x11340, 0x11340, CellClass::Extend},
+	{0x11366, 0x1136C, CellClass::Extend},
+	{0x11370, 0x11374, CellClass::Extend},
+	{0x11438, 0x1143F, CellClass::Extend},
+	{0x11442, 0x11444, CellClass::Extend},
+	{0x11446, 0x11446, CellClass::Extend},
+	{0x1145E, 0x1145E, CellClass::Extend},
+	{0x114B3, 0x114B8, CellClass::Extend},
+	{0x114BA, 0x114BA, CellClass::Extend},
+	{0x114BF, 0x114C0, CellClass::Extend},
+	{0x114C2, 0x114C3, CellClass::Extend},
+	{0x115B2, 0x115B5, CellClass::Extend},
+	{0x115BC, 0x115BD, CellClass::Extend},
+	{0x115BF, 0x115C0, CellClass::Extend},
+	{0x115DC, 0x115DD, CellClass::Extend},
+	{0x11633, 0x1163A, CellClass::Extend},
+	{0x1163D, 0x1163D, CellClass::Extend},
+	{0x1163F, 0x11640, CellClass::Extend},
+	{0x116AB, 0x116AB, CellClass::Extend},
+	{0x116AD, 0x116AD, CellClass::Extend},
+	{0x116B0, 0x116B5, CellClass::Extend},
+	{0x116B7, 0x116B7, CellClass::Extend},
+	{0x1171D, 0x1171F, CellClass::Extend},
+	{0x11722, 0x11725, CellClass::Extend},
+	{0x11727, 0x1172B, CellClass::Extend},
+	{0x1182F, 0x11837, CellClass::Extend},
+	{0x11839, 0x1183A, CellClass::Extend},
+	{0x1193B, 0x1193C, CellClass::Extend},
+	{0x1193E, 0x1193E, CellClass::Extend},
+	{0x11943, 0x11943, CellClass::Extend},
+	{0x119D4, 0x119D7, CellClass::Extend},
+	{0x119DA, 0x119DB, CellClass::Extend},
+	{0x119E0, 0x119E0, CellClass::Extend},
+	{0x11A01, 0x11A0A, CellClass::Extend},
+	{0x11A33, 0x11A38, CellClass::Extend},
+	{0x11A3B, 0x11A3E, CellClass::Extend},
+	{0x11A47, 0x11A47, CellClass::Extend},
+	{0x11A51, 0x11A56, CellClass::Extend},
+	{0x11A59, 0x11A5B, CellClass::Extend},
+	{0x11A8A, 0x11A96, CellClass::Extend},
+	{0x11A98, 0x11A99, CellClass::Extend},
+	{0x11C30, 0x11C36, CellClass::Extend},
+	{0x11C38, 0x11C3D, CellClass::Extend},
+	{0x11C3F, 0x11C3F, CellClass::Extend},
+	{0x11C92, 0x11CA7, CellClass::Extend},
+	{0x11CAA, 0x11CB0, CellClass::Extend},
+	{0x11CB2, 0x11CB3, CellClass::Extend},
+	{0x11CB5, 0x11CB6, CellClass::Extend},
+	{0x11D31, 0x11D36, CellClass::Extend},
+	{0x11D3A, 0x11D3A, CellClass::Extend},
+	{0x11D3C, 0x11D3D, CellClass::Extend},
+	{0x11D3F, 0x11D45, CellClass::Extend},
+	{0x11D47, 0x11D47, CellClass::Extend},
+	{0x11D90, 0x11D91, CellClass::Extend},
+	{0x11D95, 0x11D95, CellClass::Extend},
+	{0x11D97, 0x11D97, CellClass::Extend},
+	{0x11EF3, 0x11EF4, CellClass::Extend},
+	{0x11F00, 0x11F01, CellClass::Extend},
+	{0x11F36, 0x11F3A, CellClass::Extend},
+	{0x11F40, 0x11F40, CellClass::Extend},
+	{0x11F42, 0x11F42, CellClass::Extend},
+	{0x13430, 0x13440, CellClass::Extend},
+	{0x13447, 0x13455, CellClass::Extend},
+	{0x16AF0, 0x16AF4, CellClass::Extend},
+	{0x16B30, 0x16B36, CellClass::Extend},
+	{0x16F4F, 0x16F4F, CellClass::Extend},
+	{0x16F8F, 0x16F92, CellClass::Extend},
+	{0x16FE0, 0x16FE3, CellClass::Wide},
+	{0x16FE4, 0x16FE4, CellClass::Extend},
+	{0x16FF0, 0x16FF1, CellClass::Wide},
+	{0x17000, 0x187F7, CellClass::Wide},
+	{0x18800, 0x18CD5, CellClass::Wide},
+	{0x18D00, 0x18D08, CellClass::Wide},
+	{0x1AFF0, 0x1AFF3, CellClass::Wide},
+	{0x1AFF5, 0x1AFFB, CellClass::Wide},
+	{0x1AFFD, 0x1AFFE, CellClass::Wide},
+	{0x1B000, 0x1B122, CellClass::Wide},
+	{0x1B132, 0x1B132, CellClass::Wide},
+	{0x1B150, 0x1B152, CellClass::Wide},
+	{0x1B155, 0x1B155, CellClass::Wide},
+	{0x1B164, 0x1B167, CellClass::Wide},
+	{0x1B170, 0x1B2FB, CellClass::Wide},
+	{0x1BC9D, 0x1BC9E, CellClass::Extend},
+	{0x1BCA0, 0x1BCA3, CellClass::Extend},
+	{0x1CF00, 0x1CF2D, CellClass::Extend},
+	{0x1CF30, 0x1CF46, CellClass::Extend},
+	{0x1D167, 0x1D169, CellClass::Extend},
+	{0x1D173, 0x1D182, CellClass::Extend},
+	{0x1D185, 0x1D18B, CellClass::Extend},
+	{0x1D1AA, 0x1D1AD, CellClass::Extend},
+	{0x1D242, 0x1D244, CellClass::Extend},
+	{0x1DA00, 0x1DA36, CellClass::Extend},
+	{0x1DA3B, 0x1DA6C, CellClass::Extend},
+	{0x1DA75, 0x1DA75, CellClass::Extend},
+	{0x1DA84, 0x1DA84, CellClass::Extend},
+	{0x1DA9B, 0x1DA9F, CellClass::Extend},
+	{0x1DAA1, 0x1DAAF, CellClass::Extend},
+	{0x1E000, 0x1E006, CellClass::Extend},
+	{0x1E008, 0x1E018, CellClass::Extend},
+	{0x1E01B, 0x1E021, CellClass::Extend},
+	{0x1E023, 0x1E024, CellClass::Extend},
+	{0x1E026, 0x1E02A, CellClass::Extend},
+	{0x1E08F, 0x1E08F, CellClass::Extend},
+	{0x1E130, 0x1E136, CellClass::Extend},
+	{0x1E2AE, 0x1E2AE, CellClass::Extend},
+	{0x1E2EC, 0x1E2EF, CellClass::Extend},
+	{0x1E4EC, 0x1E4EF, CellClass::Extend},
+	{0x1E8D0, 0x1E8D6, CellClass::Extend},
+	{0x1E944, 0x1E94A, CellClass::Extend},
+	{0x1F000, 0x1F003, CellClass::Pictographic},
+	{0x1F004, 0x1F004, CellClass::PictographicWide},
+	{0x1F005, 0x1F0CE, CellClass::Pictographic},
+	{0x1F0CF, 0x1F0CF, CellClass::PictographicWide},
+	{0x1F0D0, 0x1F0FF, CellClass::Pictographic},
+	{0x1F10D, 0x1F10F, CellClass::Pictographic},
+	{0x1F12F, 0x1F12F, CellClass::Pictographic},
+	{0x1F16C, 0x1F171, CellClass::Pictographic},
+	{0x1F17E, 0x1F17F, CellClass::Pictographic},
+	{0x1F18E, 0x1F18E, CellClass::PictographicWide},
+	{0x1F191, 0x1F19A, CellClass::PictographicWide},
+	{0x1F1AD, 0x1F1E5, CellClass::Pictographic},
+	{0x1F1E6, 0x1F1FF, CellClass::RegionalIndicator},
+	{0x1F200, 0x1F200, CellClass::Wide},
+	{0x1F201, 0x1F202, CellClass::PictographicWide},
+	{0x1F203, 0x1F20F, CellClass::Pictographic},
+	{0x1F210, 0x1F219, CellClass::Wide},
+	{0x1F21A, 0x1F21A, CellClass::PictographicWide},
+	{0x1F21B, 0x1F22E, CellClass::Wide},
+	{0x1F22F, 0x1F22F, CellClass::PictographicWide},
+	{0x1F230, 0x1F231, CellClass::Wide},
+	{0x1F232, 0x1F23A, CellClass::PictographicWide},
+	{0x1F23B, 0x1F23B, CellClass::Wide},
+	{0x1F23C, 0x1F23F, CellClass::Pictographic},
+	{0x1F240, 0x1F248, CellClass::Wide},
+	{0x1F249, 0x1F24F, CellClass::Pictographic},
+	{0x1F250, 0x1F251, CellClass::PictographicWide},
+	{0x1F252, 0x1F25F, CellClass::Pictographic},
+	{0x1F260, 0x1F265, CellClass::PictographicWide},
+	{0x1F266, 0x1F2FF, CellClass::Pictographic},
+	{0x1F300, 0x1F320, CellClass::PictographicWide},
+	{0x1F321, 0x1F32C, CellClass::Pictographic},
+	{0x1F32D, 0x1F335, CellClass::PictographicWide},
+	{0x1F336, 0x1F336, CellClass::Pictographic},
+	{0x1F337, 0x1F37C, CellClass::PictographicWide},
+	{0x1F37D, 0x1F37D, CellClass::Pictographic},
+	{0x1F37E, 0x1F393, CellClass::PictographicWide},
+	{0x1F394, 0x1F39F, CellClass::Pictographic},
+	{0x1F3A0, 0x1F3CA, CellClass::PictographicWide},
+	{0x1F3CB, 0x1F3CE, CellClass::Pictographic},
+	{0x1F3CF, 0x1F3D3, CellClass::PictographicWide},
+	{0x1F3D4, 0x1F3DF, CellClass::Pictographic},
+	{0x1F3E0, 0x1F3F0, CellClass::PictographicWide},
+	{0x1F3F1, 0x1F3F3, CellClass::Pictographic},
+	{0x1F3F4, 0x1F3F4, CellClass::PictographicWide},
+	{0x1F3F5, 0x1F3F7, CellClass::Pictographic},
+	{0x1F3F8, 0x1F3FA, CellClass::PictographicWide},
+	{0x1F3FB, 0x1F3FF, CellClass::Extend},
+	{0x1F400, 0x1F43E, CellClass::PictographicWide},
+	{0x1F43F, 0x1F43F, CellClass::Pictographic},
+	{0x1F440, 0x1F440, CellClass::PictographicWide},
+	{0x1F441, 0x1F441, CellClass::Pictographic},
+	{0x1F442, 0x1F4FC, CellClass::PictographicWide},
+	{0x1F4FD, 0x1F4FE, CellClass::Pictographic},
+	{0x1F4FF, 0x1F53D, CellClass::PictographicWide},
+	{0x1F546, 0x1F54A, CellClass::Pictographic},
+	{0x1F54B, 0x1F54E, CellClass::PictographicWide},
+	{0x1F54F, 0x1F54F, CellClass::Pictographic},
+	{0x1F550, 0x1F567, CellClass::PictographicWide},
+	{0x1F568, 0x1F579, CellClass::Pictographic},
+	{0x1F57A, 0x1F57A, CellClass::PictographicWide},
+	{0x1F57B, 0x1F594, CellClass::Pictographic},
+	{0x1F595, 0x1F596, CellClass::PictographicWide},
+	{0x1F597, 0x1F5A3, CellClass::Pictographic},
+	{0x1F5A4, 0x1F5A4, CellClass::PictographicWide},
+	{0x1F5A5, 0x1F5FA, CellClass::Pictographic},
+	{0x1F5FB, 0x1F64F, CellClass::PictographicWide},
+	{0x1F680, 0x1F6C5, CellClass::PictographicWide},
+	{0x1F6C6, 0x1F6CB, CellClass::Pictographic},
+	{0x1F6CC, 0x1F6CC, CellClass::PictographicWide},
+	{0x1F6CD, 0x1F6CF, CellClass::Pictographic},
+	{0x1F6D0, 0x1F6D2, CellClass::PictographicWide},
+	{0x1F6D3, 0x1F6D4, CellClass::Pictographic},
+	{0x1F6D5, 0x1F6D7, CellClass::PictographicWide},
+	{0x1F6D8, 0x1F6DB, CellClass::Pictographic},
+	{0x1F6DC, 0x1F6DF, CellClass::PictographicWide},
+	{0x1F6E0, 0x1F6EA, CellClass::Pictographic},
+	{0x1F6EB, 0x1F6EC, CellClass::PictographicWide},
+	{0x1F6ED, 0x1F6F3, CellClass::Pictographic},
+	{0x1F6F4, 0x1F6FC, CellClass::PictographicWide},
+	{0x1F6FD, 0x1F6FF, CellClass::Pictographic},
+	{0x1F774, 0x1F77F, CellClass::Pictographic},
+	{0x1F7D5, 0x1F7DF, CellClass::Pictographic},
+	{0x1F7E0, 0x1F7EB, CellClass::PictographicWide},
+	{0x1F7EC, 0x1F7EF, CellClass::Pictographic},
+	{0x1F7F0, 0x1F7F0, CellClass::PictographicWide},
+	{0x1F7F1, 0x1F7FF, CellClass::Pictographic},
+	{0x1F80C, 0x1F80F, CellClass::Pictographic},
+	{0x1F848, 0x1F84F, CellClass::Pictographic},
+	{0x1F85A, 0x1F85F, CellClass::Pictographic},
+	{0x1F888, 0x1F88F, CellClass::Pictographic},
+	{0x1F8AE, 0x1F8FF, CellClass::Pictographic},
+	{0x1F90C, 0x1F93A, CellClass::PictographicWide},
+	{0x1F93C, 0x1F945, CellClass::PictographicWide},
+	{0x1F947, 0x1F9FF, CellClass::PictographicWide},
+	{0x1FA00, 0x1FA6F, CellClass::Pictographic},
+	{0x1FA70, 0x1FA7C, CellClass::PictographicWide},
+	{0x1FA7D, 0x1FA7F, CellClass::Pictographic},
+	{0x1FA80, 0x1FA88, CellClass::PictographicWide},
+	{0x1FA89, 0x1FA8F, CellClass::Pictographic},
+	{0x1FA90, 0x1FABD, CellClass::PictographicWide},
+	{0x1FABE, 0x1FABE, CellClass::Pictographic},
+	{0x1FABF, 0x1FAC5, CellClass::PictographicWide},
+	{0x1FAC6, 0x1FACD, CellClass::Pictographic},
+	{0x1FACE, 0x1FADB, CellClass::PictographicWide},
+	{0x1FADC, 0x1FADF, CellClass::Pictographic},
+	{0x1FAE0, 0x1FAE8, CellClass::PictographicWide},
+	{0x1FAE9, 0x1FAEF, CellClass::Pictographic},
+	{0x1FAF0, 0x1FAF8, CellClass::PictographicWide},
+	{0x1FAF9, 0x1FAFF, CellClass::Pictographic},
+	{0x1FC00, 0x1FFFD, CellClass::Pictographic},
+	{0x20000, 0x2FFFD, CellClass::Wide},
+	{0x30000, 0x3FFFD, CellClass::Wide},
+};
+
+} // namespace Scintilla::Internal
+
+#endif
@@ -0,0 +1,233 @@
+// Copyright 2012-2024 Mitchell. See LICENSE.
+// Scripted rendering benchmarks for Scinterm.
+// Runs workloads against a Scintilla window on a curses screen whose output goes to a
+// temporary file, and reports per-frame latency percentiles along with the number of bytes
+// emitted to the terminal.
+
+#include <dlfcn.h>
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <curses.h>
+
+#include "Scintilla.h"
+#include "SciLexer.h"
+#include "Lexilla.h"
+#include "ScintillaCurses.h"
+
+#define SSM(m, w, l) scintilla_send_message(sci, m, w, l)
+
+typedef void Scintilla;
+
+// Frame latencies and bytes emitted for a workload.
+struct stats {
+	const char *name;
+	double *ms;
+	int frames, size;
+	long bytes;
+};
+
+static FILE *out; // terminal output
+static long emitted; // terminal output size as of the last frame
+static struct timespec start; // start time of the current frame
+static struct stats results[16];
+static int nresults;
+
+void scnotification(Scintilla *view, int msg, SCNotification *n, void *userdata) {}
+
+// Returns the number of bytes written to the terminal so far.
+static long output_size() {
+	struct stat st;
+	fflush(out), fstat(fileno(out), &st);
+	return st.st_size;
+}
+
+// Starts timing a frame.
+static void frame_begin() { clock_gettime(CLOCK_MONOTONIC, &start); }
+
+// Refreshes the Scintilla window and records the time since `frame_begin()` along with the
+// number of bytes written to the terminal.
+static void frame_end(Scintilla *sci, struct stats *s) {
+	scintilla_refresh(sci);
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if (s->frames == s->size) s->ms = realloc(s->ms, (s->size = s->size * 2 + 64) * sizeof(double));
+	s->ms[s->frames++] = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+	long size = output_size();
+	s->bytes += size - emitted, emitted = size;
+}
+
+// Returns a new workload to record stats for.
+static struct stats *workload(const char *name) {
+	struct stats *s = &results[nresults++];
+	memset(s, 0, sizeof(struct stats)), s->name = name;
+	return s;
+}
+
+static int compare(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return x < y ? -1 : x > y;
+}
+
+// Returns the given percentile of the sorted frame latencies.
+static double percentile(struct stats *s, double p) {
+	int i = (int)(p / 100 * s->frames + 0.5) - 1;
+	return s->ms[i < 0 ? 0 : i >= s->frames ? s->frames - 1 : i];
+}
+
+static void report(FILE *f) {
+	fprintf(f, "%-14s %7s %9s %9s %9s %9s %12s %9s\n", "workload", "frames", "p50 ms", "p90 ms",
+		"p99 ms", "max ms", "bytes", "bytes/fr");
+	for (int i = 0; i < nresults; i++) {
+		struct stats *s = &results[i];
+		if (s->frames == 0) continue;
+		qsort(s->ms, s->frames, sizeof(double), compare);
+		fprintf(f, "%-14s %7d %9.3f %9.3f %9.3f %9.3f %12ld %9ld\n", s->name, s->frames,
+			percentile(s, 50), percentile(s, 90), percentile(s, 99), s->ms[s->frames - 1], s->bytes,
+			s->bytes / s->frames);
+	}
+}
+
+// Returns C-like text of roughly the given number of bytes.
+static char *generate_text(long size) {
+	static const char *lines[] = {"int main(int argc, char **argv) {\n",
+		"  // Start up the gnome and print a reasonably long line of text for wrapping purposes.\n",
+		"  gnome_init(\"stest\", \"1.0\", argc, argv); /* comment */\n",
+		"  for (int i = 0; i < 0x10; i++) printf(\"%d\\n\", i * 42);\n", "}\n"};
+	char *text = malloc(size + 128);
+	long len = 0;
+	for (int i = 0; len < size; i = (i + 1) % (sizeof(lines) / sizeof(lines[0])))
+		len += sprintf(text + len, "%s", lines[i]);
+	return text;
+}
+
+static void usage() {
+	fprintf(stderr, "usage: jinx-bench [-s MiB] [-r rows] [-c columns] [-o file]\n");
+	exit(1);
+}
+
+int main(int argc, char **argv) {
+	long mib = 100;
+	int rows = 24, cols = 80, opt;
+	const char *output = NULL;
+	while ((opt = getopt(argc, argv, "s:r:c:o:")) != -1)
+		if (opt == 's')
+			mib = atol(optarg);
+		else if (opt == 'r')
+			rows = atoi(optarg);
+		else if (opt == 'c')
+			cols = atoi(optarg);
+		else if (opt == 'o')
+			output = optarg;
+		else
+			usage();
+
+	setlocale(LC_CTYPE, ""); // for drawing UTF-8 characters properly
+	char env[16];
+	sprintf(env, "%d", rows), setenv("LINES", env, 1);
+	sprintf(env, "%d", cols), setenv("COLUMNS", env, 1);
+	out = tmpfile();
+	FILE *in = fopen("/dev/null", "r");
+	if (!out || !in || !newterm("xterm-256color", out, in)) {
+		fprintf(stderr, "jinx-bench: unable to create a terminal\n");
+		return 1;
+	}
+	raw(), cbreak(), noecho(), start_color();
+	Scintilla *sci = scintilla_new(scnotification, NULL);
+	char lexilla_path[] = "../../../lexilla/bin/" LEXILLA_LIB LEXILLA_EXTENSION;
+	void *lexilla = dlopen(lexilla_path, RTLD_LAZY);
+	CreateLexerFn lexer = lexilla ? (CreateLexerFn)dlsym(lexilla, LEXILLA_CREATELEXER) : NULL;
+
+	SSM(SCI_STYLESETFORE, STYLE_DEFAULT, 0xFFFFFF);
+	SSM(SCI_STYLESETBACK, STYLE_DEFAULT, 0);
+	SSM(SCI_STYLECLEARALL, 0, 0);
+	if (lexer) SSM(SCI_SETILEXER, 0, (sptr_t)lexer("cpp"));
+	SSM(SCI_SETKEYWORDS, 0, (sptr_t) "int char for");
+	SSM(SCI_STYLESETFORE, SCE_C_COMMENT, 0x00FF00);
+	SSM(SCI_STYLESETFORE, SCE_C_COMMENTLINE, 0x00FF00);
+	SSM(SCI_STYLESETFORE, SCE_C_NUMBER, 0xFFFF00);
+	SSM(SCI_STYLESETFORE, SCE_C_WORD, 0xFF0000);
+	SSM(SCI_STYLESETFORE, SCE_C_STRING, 0xFF00FF);
+	SSM(SCI_STYLESETBOLD, SCE_C_OPERATOR, 1);
+	SSM(SCI_SETMARGINWIDTHN, 0, 8);
+	SSM(SCI_SETFOCUS, 1, 0);
+	scintilla_refresh(sci);
+	emitted = output_size();
+
+	// Open a large file.
+	struct stats *s = workload("open");
+	char *text = generate_text(mib * 1024 * 1024);
+	frame_begin(), SSM(SCI_SETTEXT, 0, (sptr_t)text), frame_end(sci, s);
+	free(text);
+
+	// Page through it.
+	s = workload("page");
+	for (int i = 0; i < 2000; i++)
+		frame_begin(), scintilla_send_key(sci, SCK_NEXT, SCMOD_NORM), frame_end(sci, s);
+
+	// Type into it.
+	s = workload("type");
+	SSM(SCI_GOTOPOS, SSM(SCI_POSITIONFROMLINE, SSM(SCI_GETFIRSTVISIBLELINE, 0, 0) + rows / 2, 0), 0);
+	const char *typing = "for (int j = 0; j < n; j++) total += values[j];";
+	for (int i = 0; i < 10000; i++) {
+		int c = typing[i % strlen(typing)];
+		if (i % strlen(typing) == 0) c = '\n';
+		frame_begin(), scintilla_send_key(sci, c, SCMOD_NORM), frame_end(sci, s);
+	}
+
+	// Paste into it.
+	s = workload("paste");
+	text = generate_text(1024 * 1024);
+	frame_begin(), scintilla_send_text(sci, text, strlen(text), true), frame_end(sci, s);
+	free(text);
+
+	// Drag-select down the screen and back up, scrolling at the edges.
+	s = workload("drag-select");
+	frame_begin(), scintilla_send_mouse(sci, SCM_PRESS, 1, 0, 1, 10), frame_end(sci, s);
+	for (int i = 0; i < 1000; i++) {
+		int y = i % (2 * rows), x = 10 + i % (cols - 20);
+		if (y >= rows) y = 2 * rows - 1 - y;
+		frame_begin(), scintilla_send_mouse(sci, SCM_DRAG, 0, 0, y, x), frame_end(sci, s);
+	}
+	frame_begin(), scintilla_send_mouse(sci, SCM_RELEASE, 1, 0, 1, 10), frame_end(sci, s);
+
+	// Re-wrap on resize.
+	s = workload("resize-wrap");
+	SSM(SCI_SETWRAPMODE, SC_WRAP_WORD, 0);
+	for (int i = 0; i < 200; i++) {
+		int width = cols - i % (cols / 2);
+		frame_begin(), resizeterm(rows, width), scintilla_resize(sci, rows, width), frame_end(sci, s);
+	}
+	resizeterm(rows, cols), scintilla_resize(sci, rows, cols);
+	SSM(SCI_SETWRAPMODE, SC_WRAP_NONE, 0);
+	scintilla_refresh(sci);
+
+	// Autocomplete with many items, then navigate and filter the list.
+	s = workload("autocomplete");
+	char *items = malloc(100000 * 12), *p = items;
+	for (int i = 0; i < 100000; i++) p += sprintf(p, i > 0 ? " item%06d" : "item%06d", i);
+	SSM(SCI_AUTOCSETMAXHEIGHT, rows / 2, 0);
+	frame_begin(), SSM(SCI_AUTOCSHOW, 0, (sptr_t)items), frame_end(sci, s);
+	free(items);
+	for (int i = 0; i < 500; i++)
+		frame_begin(), scintilla_send_key(sci, SCK_DOWN, SCMOD_NORM), frame_end(sci, s);
+	const char *filter = "item09999";
+	for (const char *c = filter; *c; c++)
+		frame_begin(), scintilla_send_key(sci, *c, SCMOD_NORM), frame_end(sci, s);
+	SSM(SCI_AUTOCCANCEL, 0, 0);
+
+	scintilla_delete(sci);
+	endwin();
+
+	FILE *f = output ? fopen(output, "w") : stdout;
+	if (!f) return (perror(output), 1);
+	fprintf(f, "%ld MiB, %dx%d, lexer %s\n", mib, rows, cols, lexer ? "cpp" : "none");
+	report(f);
+	if (f != stdout) fclose(f);
+
+	return 0;
+}
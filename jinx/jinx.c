@@ -51,6 +51,7 @@ int main(int argc, char **argv) {
 	SSM(SCI_SETMARGINSENSITIVEN, 2, 1);
 	SSM(SCI_SETAUTOMATICFOLD, SC_AUTOMATICFOLD_CLICK, 0);
 	SSM(SCI_SETFOCUS, 1, 0);
+	scintilla_set_frame_rate(sci, 60); // paint at most 60 frames per second
 	scintilla_refresh(sci);
 
 	printf("\033[?1000h"); // enable mouse press and release events
@@ -63,8 +64,10 @@ int main(int argc, char **argv) {
 	int c = 0;
 	MEVENT mouse;
 	WINDOW *win = scintilla_get_window(sci);
-	while ((c = wgetch(win)) != 'q') {
-		if (c != KEY_MOUSE) {
+	while (wtimeout(win, scintilla_get_timeout(sci)), (c = wgetch(win)) != 'q') {
+		if (c == ERR)
+			scintilla_process_timers(sci);
+		else if (c != KEY_MOUSE) {
 			if (c == KEY_UP)
 				c = SCK_UP;
 			else if (c == KEY_DOWN)
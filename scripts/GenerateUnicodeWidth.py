@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+# Copyright 2012-2024 Mitchell. See LICENSE.
+# Generates UnicodeWidth.h, the table of terminal cell classes used for measuring text.
+# The Unicode version is that of Python's unicodedata module.
+# Usage: python3 scripts/GenerateUnicodeWidth.py > UnicodeWidth.h
+
+import unicodedata
+
+# Extended_Pictographic code points from emoji-data.txt (not provided by unicodedata).
+PICTOGRAPHIC = [
+	(0x00A9, 0x00A9), (0x00AE, 0x00AE), (0x203C, 0x203C), (0x2049, 0x2049), (0x2122, 0x2122),
+	(0x2139, 0x2139), (0x2194, 0x2199), (0x21A9, 0x21AA), (0x231A, 0x231B), (0x2328, 0x2328),
+	(0x2388, 0x2388), (0x23CF, 0x23CF), (0x23E9, 0x23F3), (0x23F8, 0x23FA), (0x24C2, 0x24C2),
+	(0x25AA, 0x25AB), (0x25B6, 0x25B6), (0x25C0, 0x25C0), (0x25FB, 0x25FE), (0x2600, 0x2605),
+	(0x2607, 0x2612), (0x2614, 0x2685), (0x2690, 0x2705), (0x2708, 0x2712), (0x2714, 0x2714),
+	(0x2716, 0x2716), (0x271D, 0x271D), (0x2721, 0x2721), (0x2728, 0x2728), (0x2733, 0x2734),
+	(0x2744, 0x2744), (0x2747, 0x2747), (0x274C, 0x274C), (0x274E, 0x274E), (0x2753, 0x2755),
+	(0x2757, 0x2757), (0x2763, 0x2767), (0x2795, 0x2797), (0x27A1, 0x27A1), (0x27B0, 0x27B0),
+	(0x27BF, 0x27BF), (0x2934, 0x2935), (0x2B05, 0x2B07), (0x2B1B, 0x2B1C), (0x2B50, 0x2B50),
+	(0x2B55, 0x2B55), (0x3030, 0x3030), (0x303D, 0x303D), (0x3297, 0x3297), (0x3299, 0x3299),
+	(0x1F000, 0x1F0FF), (0x1F10D, 0x1F10F), (0x1F12F, 0x1F12F), (0x1F16C, 0x1F171),
+	(0x1F17E, 0x1F17F), (0x1F18E, 0x1F18E), (0x1F191, 0x1F19A), (0x1F1AD, 0x1F1E5),
+	(0x1F201, 0x1F20F), (0x1F21A, 0x1F21A), (0x1F22F, 0x1F22F), (0x1F232, 0x1F23A),
+	(0x1F23C, 0x1F23F), (0x1F249, 0x1F3FA), (0x1F400, 0x1F53D), (0x1F546, 0x1F64F),
+	(0x1F680, 0x1F6FF), (0x1F774, 0x1F77F), (0x1F7D5, 0x1F7FF), (0x1F80C, 0x1F80F),
+	(0x1F848, 0x1F84F), (0x1F85A, 0x1F85F), (0x1F888, 0x1F88F), (0x1F8AE, 0x1F8FF),
+	(0x1F90C, 0x1F93A), (0x1F93C, 0x1F945), (0x1F947, 0x1FAFF), (0x1FC00, 0x1FFFD)
+]
+
+# Unassigned code points in these blocks default to East Asian Wide.
+WIDE_BLOCKS = [(0x3400, 0x4DBF), (0x4E00, 0x9FFF), (0xF900, 0xFAFF), (0x20000, 0x2FFFD),
+	(0x30000, 0x3FFFD)]
+
+# Format characters that are visible, and thus not zero-width.
+VISIBLE_FORMATS = {0x00AD, 0x0600, 0x0601, 0x0602, 0x0603, 0x0604, 0x0605, 0x06DD, 0x070F, 0x0890,
+	0x0891, 0x08E2, 0x110BD, 0x110CD}
+
+TABLE_END = 0x40000 # must match `tableEnd` in PlatCurses.cxx
+
+pictographic = set()
+for first, last in PICTOGRAPHIC: pictographic.update(range(first, last + 1))
+
+def cell_class(ch):
+	if 0xD800 <= ch <= 0xDFFF: return 'Narrow'
+	if ch < 0x20 or 0x7F <= ch < 0xA0: return 'Control'
+	if ch == 0x200D: return 'ZWJ'
+	if 0x1F1E6 <= ch <= 0x1F1FF: return 'RegionalIndicator'
+	if 0x1F3FB <= ch <= 0x1F3FF: return 'Extend' # emoji modifiers
+	category = unicodedata.category(chr(ch))
+	if category in ('Mn', 'Me') or (category == 'Cf' and ch not in VISIBLE_FORMATS): return 'Extend'
+	if 0x1160 <= ch <= 0x11FF or 0xD7B0 <= ch <= 0xD7FF: return 'Extend' # Hangul vowels and finals
+	wide = unicodedata.east_asian_width(chr(ch)) in ('W', 'F') or (category == 'Cn' and
+		any(first <= ch <= last for first, last in WIDE_BLOCKS))
+	if ch in pictographic: return 'PictographicWide' if wide else 'Pictographic'
+	return 'Wide' if wide else 'Narrow'
+
+ranges = []
+for ch in range(TABLE_END):
+	cls = cell_class(ch)
+	if ranges and ranges[-1][2] == cls:
+		ranges[-1][1] = ch
+	else:
+		ranges.append([ch, ch, cls])
+# Code points past the table are Narrow, except for tags and variation selectors, which are
+# handled by `cell_class()` in PlatCurses.cxx.
+for ch in range(TABLE_END, 0x110000):
+	cls = cell_class(ch)
+	assert cls == 'Narrow' or (cls == 'Extend' and 0xE0000 <= ch <= 0xE0FFF), hex(ch)
+
+print('// Copyright 2012-2024 Mitchell. See LICENSE.')
+print('// Terminal cell classes of Unicode code points for measuring text.')
+print('// Generated by scripts/GenerateUnicodeWidth.py from Unicode %s. Do not edit.' %
+	unicodedata.unidata_version)
+print('''
+#ifndef UNICODE_WIDTH_H
+#define UNICODE_WIDTH_H
+
+namespace Scintilla::Internal {
+
+/**
+ * Classes of code points, as far as terminal cell widths and grapheme cluster boundaries
+ * are concerned.
+ */
+enum class CellClass : unsigned char {
+	Narrow, // a single cell
+	Wide, // two cells
+	Extend, // extends the preceding grapheme cluster, taking up no cells
+	ZWJ, // zero width joiner, which joins pictographs
+	RegionalIndicator, // a single cell, or two when paired into a flag
+	Pictographic, // a single cell, or two when followed by an emoji variation selector
+	PictographicWide, // two cells
+	Control // a single cell, never extended
+};
+
+struct CellClassRange {
+	char32_t first;
+	char32_t last;
+	CellClass cellClass;
+};
+
+// Ranges of code points that are not `CellClass::Narrow`, in order.
+constexpr CellClassRange cellClassRanges[] = {''')
+for first, last, cls in ranges:
+	if cls != 'Narrow': print('\t{0x%04X, 0x%04X, CellClass::%s},' % (first, last, cls))
+print('''};
+
+} // namespace Scintilla::Internal
+
+#endif''')